@@ -0,0 +1,425 @@
+// Microbenchmarks for the simulation hot paths.
+//
+// Build and run:
+//   g++ -std=c++17 -O2 bench.cpp -o antiaereo-bench -lncurses -lpthread
+//   ./antiaereo-bench [filter]
+//
+// The game is compiled in (main.cpp without its main), so every benchmark
+// drives the real functions. Each line reports time and heap allocations
+// per operation; "op" is stated per benchmark (one enemy step, one lookup...).
+#define ANTIAEREO_NO_MAIN
+#include "main.cpp"
+
+#include <new>
+#include <cstdlib>
+
+// ---------- Allocation counter ----------
+static std::atomic<uint64_t> allocCount{0};
+
+// new and delete reach malloc and free only through these two, kept out of
+// line: once inlined, GCC pairs a free with the new it came from and warns
+// (-Wmismatched-new-delete), although the pair is consistent here
+__attribute__((noinline)) static void* countedAlloc(size_t n) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return malloc(n ? n : 1);
+}
+__attribute__((noinline)) static void countedFree(void* p) { free(p); }
+
+void* operator new(size_t n) {
+    if (void* p = countedAlloc(n)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { countedFree(p); }
+void operator delete(void* p, size_t) noexcept { countedFree(p); }
+
+// ---------- Harness ----------
+static const char* benchFilter = nullptr;
+
+// run setup(), then time run() once; run returns how many operations it performed
+template <typename S, typename F>
+void bench(const char* name, S setup, F run) {
+    if (benchFilter && !strstr(name, benchFilter)) return;
+    setup();
+    uint64_t allocs0 = allocCount.load();
+    auto t0 = std::chrono::steady_clock::now();
+    int64_t ops = run();
+    auto t1 = std::chrono::steady_clock::now();
+    uint64_t allocs = allocCount.load() - allocs0;
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    if (ops <= 0) ops = 1;
+    printf("%-36s %12lld ops %12.1f ns/op %10.4f allocs/op\n",
+           name, (long long)ops, ns / ops, (double)allocs / ops);
+}
+
+// empty world on a width x height field
+static void resetWorld(int width, int height) {
+    SCREEN_W = width;
+    SCREEN_H = height;
+    enemies = EnemyTable();
+    rockets = RocketTable();
+    enemyGrid.reset(SCREEN_W, SCREEN_H);
+    destroyedEnemies = 0;
+    groundHits = 0;
+}
+
+// n enemies at random cells in the upper half of the field
+static void spawnWave(int n, std::mt19937& r) {
+    std::uniform_int_distribution<int> dx(1, SCREEN_W - 2), dy(1, SCREEN_H / 2);
+    for (int i = 0; i < n; ++i) {
+        Enemy e;
+        e.id = i + 1;
+        e.x = dx(r);
+        e.y = dy(r);
+        e.alive = true;
+        e.stepAcc = 0;
+        e.self = enemies.insert(e);
+        enemyGrid.insert((int)e.self.index, e.x, e.y);
+    }
+}
+
+static void spawnRockets(int n, Aim aim) {
+    for (int i = 0; i < n; ++i) {
+        Rocket rr;
+        rr.id = i + 1;
+        rr.aim = aim;
+        rr.stepAcc = 0;
+        rr.x = 1 + i % (SCREEN_W - 2);
+        rr.y = SCREEN_H - 3;
+        rr.self = rockets.insert(rr);
+    }
+}
+
+static const int WAVES[] = { 10, 100, 1000, 10000, 100000 };
+
+// ---------- Benchmarks ----------
+
+// op = one enemy advanced by one tick (every tick is a step)
+static void benchEnemySteps() {
+    for (int n : WAVES) {
+        char name[64];
+        snprintf(name, sizeof(name), "tickEnemies/%d", n);
+        bench(name, [&] {
+            std::mt19937 r(1);
+            resetWorld(1000, 1000);
+            settings.enemy_step_ms = TICK_MS;
+            spawnWave(n, r);
+        }, [&]() -> int64_t {
+            int ticks = 200;
+            int64_t ops = 0;
+            for (int t = 0; t < ticks; ++t) {
+                ops += (int64_t)enemies.size();
+                tickEnemies();
+            }
+            return ops;
+        });
+    }
+}
+
+// op = one rocket advanced by one tick, against an empty sky
+static void benchRocketSteps() {
+    for (int n : { 10, 1000, 100000 }) {
+        char name[64];
+        snprintf(name, sizeof(name), "tickRockets/%d", n);
+        bench(name, [&] {
+            resetWorld(1000, 1000);
+            settings = HARD;
+            spawnRockets(n, AIM_UP);
+        }, [&]() -> int64_t {
+            int ticks = 700;     // 100 rocket steps
+            int64_t ops = 0;
+            for (int t = 0; t < ticks; ++t) {
+                ops += (int64_t)rockets.size();
+                tickRockets();
+            }
+            return ops;
+        });
+    }
+}
+
+// op = one rocket swept by one tick while parked (it steps far less often
+// than the enemies); every enemy that falls onto a rocket must be destroyed,
+// so the kill count is printed next to the one expected
+static void benchParkedRockets() {
+    for (int n : { 100, 10000 }) {
+        char name[64];
+        snprintf(name, sizeof(name), "tickRockets/parked/%d", n);
+        int expected = 0;
+        bench(name, [&] {
+            resetWorld(1000, 150);
+            settings = HARD;
+            settings.enemy_step_ms = TICK_MS / 2;     // two rows per tick
+            rocketStepMs = 1 << 20;                     // never steps during the run
+            // one rocket per column on row 100 and one enemy above it on row 1..50
+            std::mt19937 r(6);
+            std::uniform_int_distribution<int> dy(1, 50);
+            for (int i = 0; i < n; ++i) {
+                Rocket rr;
+                rr.id = i + 1; rr.aim = AIM_UP; rr.stepAcc = 0; rr.firedNs = 0;
+                rr.x = 1 + i % (SCREEN_W - 2);
+                rr.y = 100;
+                rr.self = rockets.insert(rr);
+                if (i >= SCREEN_W - 2) continue;     // one enemy per column
+                Enemy e;
+                e.id = i + 1; e.x = rr.x; e.y = dy(r); e.alive = true; e.stepAcc = 0;
+                e.self = enemies.insert(e);
+                enemyGrid.insert((int)e.self.index, e.x, e.y);
+            }
+            expected = (int)enemies.size();
+        }, [&]() -> int64_t {
+            int64_t ops = 0;
+            for (int t = 0; t < 60; ++t) {           // every enemy reaches row 100
+                ops += (int64_t)rockets.size();
+                tickEnemies();
+                tickRockets();
+                groundEnemies();
+            }
+            rocketStepMs = ROCKET_STEP_MS;
+            return ops;
+        });
+        if (!benchFilter || strstr(name, benchFilter))
+            printf("  destroyed %d of %d\n", destroyedEnemies.load(), expected);
+    }
+}
+
+// op = one rocket swept by one tick against an enemy on its landing step:
+// every enemy stands on the rockets' row, one step from the ground, with a
+// five-cell-per-tick rocket two cells to its right flying left. Each rocket
+// meets its enemy before it lands, so all n must be destroyed and none
+// reach the ground
+static void benchLandingRockets() {
+    for (int n : { 10, 1000 }) {
+        char name[64];
+        snprintf(name, sizeof(name), "tickRockets/landing/%d", n);
+        bench(name, [&] {
+            resetWorld(n * 10 + 10, 40);
+            settings = HARD;
+            settings.enemy_step_ms = TICK_MS;          // lands on this tick
+            rocketStepMs = TICK_MS / 5;                 // five cells per tick
+            for (int i = 0; i < n; ++i) {
+                Enemy e;
+                e.id = i + 1; e.x = 10 + i * 10; e.y = SCREEN_H - 3; e.alive = true; e.stepAcc = 0;
+                e.self = enemies.insert(e);
+                enemyGrid.insert((int)e.self.index, e.x, e.y);
+                Rocket rr;
+                rr.id = i + 1; rr.aim = AIM_LEFT; rr.stepAcc = 0; rr.firedNs = 0;
+                rr.x = e.x + 2;
+                rr.y = SCREEN_H - 3;
+                rr.self = rockets.insert(rr);
+            }
+        }, [&]() -> int64_t {
+            int64_t ops = (int64_t)rockets.size();
+            tickEnemies();
+            tickRockets();
+            groundEnemies();
+            rocketStepMs = ROCKET_STEP_MS;
+            return ops;
+        });
+        if (!benchFilter || strstr(name, benchFilter))
+            printf("  destroyed %d of %d  ground %d\n", destroyedEnemies.load(), n, groundHits.load());
+    }
+}
+
+// op = one rocket-position hit test against a wave of n enemies
+static void benchCollision() {
+    for (int n : WAVES) {
+        char name[64];
+        snprintf(name, sizeof(name), "hitEnemyAt/%d", n);
+        std::mt19937 r(2);
+        bench(name, [&] {
+            resetWorld(1000, 1000);
+            spawnWave(n, r);
+        }, [&]() -> int64_t {
+            std::uniform_int_distribution<int> dx(1, SCREEN_W - 2), dy(1, SCREEN_H - 3);
+            int64_t probes = 1000000;
+            for (int64_t i = 0; i < probes; ++i) {
+                int x = dx(r), y = dy(r);
+                // hits reclaim the enemy; put it back so the wave size stays n
+                if (hitEnemyAt(x, y)) {
+                    Enemy e;
+                    e.id = 0; e.x = x; e.y = y; e.alive = true; e.stepAcc = 0;
+                    e.self = enemies.insert(e);
+                    enemyGrid.insert((int)e.self.index, x, y);
+                }
+            }
+            return probes;
+        });
+    }
+}
+
+// op = one rocket step swept against a wave of n enemies, as the tick engine
+// resolves hits (hitEnemyAt above is only the --entity-threads path)
+static void benchSweptCollision() {
+    static const Aim aims[] = { AIM_UP, AIM_UPLEFT, AIM_UPRIGHT, AIM_LEFT, AIM_RIGHT };
+    for (int n : WAVES) {
+        char name[64];
+        snprintf(name, sizeof(name), "sweptEnemyHit/%d", n);
+        std::mt19937 r(2);
+        int found = 0;
+        bench(name, [&] {
+            resetWorld(1000, 1000);
+            settings = HARD;
+            spawnWave(n, r);
+        }, [&]() -> int64_t {
+            std::uniform_int_distribution<int> dx(1, SCREEN_W - 2), dy(1, SCREEN_H - 3), da(0, 4);
+            int step = settings.enemy_step_ms;
+            int reach = (TICK_MS + step - 1) / step;
+            int64_t probes = 1000000;
+            found = 0;
+            for (int64_t i = 0; i < probes; ++i) {
+                int x = dx(r), y = dy(r), sx, sy;
+                aimToStep(aims[da(r)], sx, sy);
+                if (sweptEnemyHit(x, y, x + sx, y + sy, reach) != -1) found++;
+            }
+            return probes;
+        });
+        if (!benchFilter || strstr(name, benchFilter))
+            printf("  hits %d\n", found);
+    }
+}
+
+// op = one enemy copied into a snapshot (the x/y pass over the whole wave)
+static void benchSnapshot() {
+    for (int n : WAVES) {
+        char name[64];
+        snprintf(name, sizeof(name), "captureSnapshot/%d", n);
+        WorldSnapshot snap;
+        bench(name, [&] {
+            std::mt19937 r(4);
+            resetWorld(1000, 1000);
+            settings = HARD;
+            battery.reset(settings.k_launchers, true);
+            spawnWave(n, r);
+            captureSnapshot(snap);     // size the snapshot vectors once
+        }, [&]() -> int64_t {
+            int passes = std::max(1, 2000000 / n);
+            for (int i = 0; i < passes; ++i) captureSnapshot(snap);
+            return (int64_t)passes * n;
+        });
+    }
+}
+
+// op = one frame composed from a snapshot holding n enemies (80x24 screen)
+static void benchCompose() {
+    for (int n : { 10, 100, 1000 }) {
+        char name[64];
+        snprintf(name, sizeof(name), "composeFrame/%d", n);
+        WorldSnapshot snap;
+        FrameBuffer fb;
+        bench(name, [&] {
+            std::mt19937 r(3);
+            resetWorld(80, 24);
+            settings = HARD;
+            battery.reset(settings.k_launchers, true);
+            spawnWave(n, r);
+            spawnRockets(8, AIM_UP);
+            captureSnapshot(snap);
+            fb.reset(SCREEN_W, SCREEN_H);
+        }, [&]() -> int64_t {
+            int frames = 20000;
+            for (int i = 0; i < frames; ++i) composeFrame(snap, fb);
+            return frames;
+        });
+    }
+}
+
+// op = one fire plus reloading that launcher, on a k-launcher battery whose
+// lower half is empty (fire has to skip it), single thread
+static void benchBattery() {
+    for (int k : { 8, 64, 1024 }) {
+        char name[64];
+        snprintf(name, sizeof(name), "battery/fire+load/%d", k);
+        bench(name, [&] {
+            battery.reset(k, true);
+            for (int i = 0; i < k / 2; ++i) battery.fire();
+        }, [&]() -> int64_t {
+            int64_t ops = 1000000;
+            for (int64_t i = 0; i < ops; ++i) battery.load(battery.fire());
+            return ops;
+        });
+    }
+}
+
+// op = one entity advanced by one tick on the work-stealing pool: 100k
+// enemies stepping every tick onto a short field plus 10k two-cell-per-tick
+// rockets scattered through them; the kill and ground counts are printed so
+// runs with different worker counts can be compared
+static void benchParallelTick() {
+    for (int workers : { 1, 2, 4, 8 }) {
+        char name[64];
+        snprintf(name, sizeof(name), "tick/100000/workers/%d", workers);
+        bench(name, [&] {
+            std::mt19937 r(5);
+            resetWorld(1000, 150);
+            settings = HARD;
+            settings.enemy_step_ms = TICK_MS;
+            rocketStepMs = TICK_MS / 2;
+            spawnWave(100000, r);
+            spawnRockets(10000, AIM_UPRIGHT);
+            std::uniform_int_distribution<int> dy(1, SCREEN_H - 3);
+            for (size_t i = 0; i < rockets.size(); ++i) rockets.y[i] = dy(r);
+            tickPool.start(workers);
+        }, [&]() -> int64_t {
+            int64_t ops = 0;
+            for (int t = 0; t < 100; ++t) {
+                ops += (int64_t)(enemies.size() + rockets.size());
+                tickEnemies();
+                tickRockets();
+                groundEnemies();
+            }
+            tickPool.stop();
+            rocketStepMs = ROCKET_STEP_MS;
+            return ops;
+        });
+        if (!benchFilter || strstr(name, benchFilter))
+            printf("  destroyed %d  ground %d\n", destroyedEnemies.load(), groundHits.load());
+    }
+}
+
+// op = one launcher emptied here and refilled by the real loader threads
+// (reload_time_ms = 0, so this is the cost of the handoff itself)
+static void benchReload() {
+    for (int loaders : { 1, 4 }) {
+        char name[64];
+        snprintf(name, sizeof(name), "reloadThread/handoff/%d", loaders);
+        std::vector<pthread_t> tids(loaders);
+        bench(name, [&] {
+            settings = HARD;
+            settings.reload_time_ms = 0;
+            battery.reset(settings.k_launchers, true);
+            reloadJobs.reset(settings.k_launchers);
+            loaderStats.assign(loaders, LoaderStats());
+            gameRunning = true;
+            realClock.resetSleeps();     // the previous run's stopGame() cancelled them
+            for (int i = 0; i < loaders; ++i)
+                pthread_create(&tids[i], nullptr, reloadThreadFn, (void*)(intptr_t)i);
+        }, [&]() -> int64_t {
+            int64_t shots = 200000;
+            for (int64_t i = 0; i < shots; ) {
+                int l = battery.fire();
+                if (l == -1) continue;
+                queueReload(l);
+                ++i;
+            }
+
+            stopGame();
+            for (pthread_t t : tids) pthread_join(t, nullptr);
+            return shots;
+        });
+    }
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) benchFilter = argv[1];
+    benchEnemySteps();
+    benchRocketSteps();
+    benchParkedRockets();
+    benchLandingRockets();
+    benchCollision();
+    benchSweptCollision();
+    benchSnapshot();
+    benchCompose();
+    benchBattery();
+    benchParallelTick();
+    benchReload();
+    return 0;
+}
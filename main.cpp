@@ -9,25 +9,181 @@
 #include <cstring>
 #include <string>
 #include <cmath>
+#include <thread>
+#include <cstdint>
+#include <cstdarg>
+#include <set>
+#include <map>
+#include <deque>
+#include <memory>
+#include <ctime>
+#include <cstdio>
+#include <cerrno>
+#include <poll.h>
+#include <sched.h>
+#include <climits>
+#include <sys/resource.h>
+
+// ---------- Slot map ----------
+// Stable handle to an entity: slot index + generation. Freeing a slot bumps
+// its generation, so a handle kept by a finished thread can never resolve to
+// the entity that later reuses the slot.
+struct Handle {
+    uint32_t index = UINT32_MAX;
+    uint32_t gen = 0;
+};
+
+// Handle bookkeeping for entities kept packed in dense arrays: maps a
+// handle to the entity's dense position and back. Erase swaps the last
+// entity into the hole (the owner moves its own columns the same way), so
+// iterating costs the number of live entities, and freed slots are reused
+// from a free list so memory stays at the high-water mark.
+class SlotIndex {
+    struct Slot {
+        uint32_t dense = 0;    // dense position while used
+        uint32_t gen = 0;
+        bool used = false;
+    };
+
+    std::vector<uint32_t> denseSlot;   // slot index of each dense position
+    std::vector<Slot> slots;
+    std::vector<uint32_t> freeSlots;
+
+public:
+    // handle for a new entity appended at the end of the dense columns
+    Handle insert() {
+        uint32_t idx;
+        if (!freeSlots.empty()) {
+            idx = freeSlots.back();
+            freeSlots.pop_back();
+        } else {
+            idx = (uint32_t)slots.size();
+            slots.emplace_back();
+        }
+        Slot &s = slots[idx];
+        s.dense = (uint32_t)denseSlot.size();
+        s.used = true;
+        denseSlot.push_back(idx);
+        return Handle{idx, s.gen};
+    }
+
+    // dense position of h, or -1 if the handle is stale
+    int find(Handle h) const {
+        if (h.index >= slots.size()) return -1;
+        const Slot &s = slots[h.index];
+        return (s.used && s.gen == h.gen) ? (int)s.dense : -1;
+    }
+
+    // slot indices known to be live (e.g. from the grid)
+    uint32_t denseOf(uint32_t slot) const { return slots[slot].dense; }
+    Handle handleOf(uint32_t slot) const { return Handle{slot, slots[slot].gen}; }
+    uint32_t slotAt(size_t dense) const { return denseSlot[dense]; }
+
+    // free h; the owner then moves its entity at `last` into `hole` and drops
+    // the last position. false if the handle is stale.
+    bool erase(Handle h, uint32_t& hole, uint32_t& last) {
+        if (find(h) < 0) return false;
+        Slot &s = slots[h.index];
+        hole = s.dense;
+        last = (uint32_t)denseSlot.size() - 1;
+        if (hole != last) {
+            denseSlot[hole] = denseSlot[last];
+            slots[denseSlot[hole]].dense = hole;
+        }
+        denseSlot.pop_back();
+        s.used = false;
+        ++s.gen;
+        freeSlots.push_back(h.index);
+        return true;
+    }
+
+    void reserve(size_t n) {
+        denseSlot.reserve(n);
+        slots.reserve(n);
+        freeSlots.reserve(n);
+    }
+
+    size_t slotCount() const { return slots.size(); }
+};
+
+// move column[last] into column[hole] and drop the last entry, for every column
+template <typename... V>
+void swapRemove(uint32_t hole, uint32_t last, std::vector<V>&... cols) {
+    ((cols[hole] = cols[last], cols.pop_back()), ...);
+}
+
+// ---------- Entity pool ----------
+// Fixed-capacity free list of records, sized once before the game starts.
+// acquire/release never allocate; acquire returns nullptr when every record
+// is out. Used for the thread arguments handed from the spawning thread to
+// a new entity thread, which releases the record once it has copied it.
+template <typename T>
+class EntityPool {
+    std::vector<T> records;
+    std::vector<uint32_t> freeList;
+    pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+    size_t inUse = 0;
+    size_t high = 0;           // high-water mark of records out at once
+    size_t misses = 0;         // acquire calls that found the pool empty
+
+public:
+    void init(size_t capacity) {
+        records.assign(capacity, T());
+        freeList.resize(capacity);
+        for (size_t i = 0; i < capacity; ++i) freeList[i] = (uint32_t)(capacity - 1 - i);
+        inUse = high = misses = 0;
+    }
+
+    T* acquire() {
+        pthread_mutex_lock(&lock);
+        T* p = nullptr;
+        if (!freeList.empty()) {
+            p = &records[freeList.back()];
+            freeList.pop_back();
+            if (++inUse > high) high = inUse;
+        } else {
+            ++misses;
+        }
+        pthread_mutex_unlock(&lock);
+        return p;
+    }
 
-using namespace std::chrono_literals;
+    void release(T* p) {
+        pthread_mutex_lock(&lock);
+        freeList.push_back((uint32_t)(p - records.data()));
+        --inUse;
+        pthread_mutex_unlock(&lock);
+    }
+
+    size_t capacity() const { return records.size(); }
+    size_t highWater() const { return high; }
+    size_t exhausted() const { return misses; }
+};
 
 // ---------- Config / Tipos ----------
 enum Aim { AIM_UP, AIM_UPLEFT, AIM_UPRIGHT, AIM_LEFT, AIM_RIGHT };
 
 struct Enemy {
     int id;
+    Handle self;               // posição na lista global
     int x, y;
     bool alive;
-    pthread_t tid;
+    int stepAcc;               // ms acumulados desde o último passo (motor por tick)
 };
 
 struct Rocket {
     int id;
+    Handle self;
     int x, y;
     Aim aim;
-    pthread_t tid;
-    bool active;
+    int stepAcc;
+    int64_t firedNs;           // --entity-threads: when it was handed to its thread
+};
+
+// modelo de execução das entidades
+enum EngineMode {
+    ENGINE_TICK,               // uma thread de simulação avança todas as entidades
+    ENGINE_THREADS             // uma thread por inimigo / foguete (modelo original)
 };
 
 struct DifficultySettings {
@@ -38,25 +194,1509 @@ struct DifficultySettings {
     int spawn_interval_ms;     // intervalo de spawn (ms)
 };
 
-static DifficultySettings EASY   = {3, 12, 700, 1200, 900};
-static DifficultySettings MEDIUM = {5, 18, 450, 800, 600};
-static DifficultySettings HARD   = {8, 25, 250, 350, 300};
+const DifficultySettings EASY   = {3, 12, 700, 1200, 900};
+const DifficultySettings MEDIUM = {5, 18, 450, 800, 600};
+const DifficultySettings HARD   = {8, 25, 250, 350, 300};
+
+// simulation tick and default rocket speed (--rocket-step-ms)
+const int TICK_MS = 10;
+const int ROCKET_STEP_MS = 70;
+const int BOT_THINK_MS = 30;
+const int NO_ROCKETS_PAUSE_MS = 300;
+const int MAIN_LOOP_MS = 120;      // end-of-game check
+const int MIN_SCREEN_W = 60;       // smallest field the game lays out on
+const int MIN_SCREEN_H = 20;
+const int MAX_SCREEN_W = 1024;     // largest field a recording may ask for
+const int MAX_SCREEN_H = 1024;
+const int MAX_ENTITY_WORKERS = 256; // default entity pool ceiling; the rest overflows
+
+// ---------- Entity tables ----------
+// Live enemies and rockets as structure-of-arrays: one contiguous column per
+// field, position i being the same entity in every column, so the movement
+// and snapshot passes stream through only the fields they read. Entities are
+// erased as soon as they die, so there is no alive column: everything in a
+// table is alive. Guarded by enemyListMutex / rocketListMutex.
+struct EnemyTable {
+    SlotIndex index;
+    std::vector<int> id, x, y, stepAcc;
+    std::vector<int> prevY;    // y before the current tick's moves (swept hit test)
+
+    Handle insert(const Enemy& e) {
+        id.push_back(e.id);
+        x.push_back(e.x);
+        y.push_back(e.y);
+        stepAcc.push_back(e.stepAcc);
+        prevY.push_back(e.y);
+        return index.insert();
+    }
+
+    void erase(Handle h) {
+        uint32_t hole, last;
+        if (index.erase(h, hole, last)) swapRemove(hole, last, id, x, y, stepAcc, prevY);
+    }
+    void eraseAt(size_t i) { erase(index.handleOf(index.slotAt(i))); }
+
+    int find(Handle h) const { return index.find(h); }
+
+    void reserve(size_t n) {
+        index.reserve(n);
+        id.reserve(n); x.reserve(n); y.reserve(n); stepAcc.reserve(n); prevY.reserve(n);
+    }
+
+    size_t size() const { return id.size(); }
+    size_t slotCount() const { return index.slotCount(); }
+};
+
+struct RocketTable {
+    SlotIndex index;
+    std::vector<int> id, x, y, stepAcc;
+    std::vector<Aim> aim;
+
+    Handle insert(const Rocket& r) {
+        id.push_back(r.id);
+        x.push_back(r.x);
+        y.push_back(r.y);
+        stepAcc.push_back(r.stepAcc);
+        aim.push_back(r.aim);
+        return index.insert();
+    }
+
+    void erase(Handle h) {
+        uint32_t hole, last;
+        if (index.erase(h, hole, last)) swapRemove(hole, last, id, x, y, stepAcc, aim);
+    }
+    void eraseAt(size_t i) { erase(index.handleOf(index.slotAt(i))); }
+
+    int find(Handle h) const { return index.find(h); }
+
+    void reserve(size_t n) {
+        index.reserve(n);
+        id.reserve(n); x.reserve(n); y.reserve(n); stepAcc.reserve(n); aim.reserve(n);
+    }
+
+    size_t size() const { return id.size(); }
+    size_t slotCount() const { return index.slotCount(); }
+};
+
+// ---------- Spatial grid ----------
+// One cell per screen position, each holding an intrusive list of the live
+// enemies standing on it, so a hit test is a cell lookup instead of a scan
+// over the whole wave. The lists are doubly linked so an enemy leaves its
+// cell in O(1) however crowded the cell is. Indices are enemies slot
+// indices; guarded by enemyListMutex.
+struct EnemyGrid {
+    static constexpr int UNLINKED = -2;
+    int w = 0, h = 0;
+    std::vector<int> head;     // first enemy in each cell, -1 if empty
+    std::vector<int> next;     // next enemy in the same cell, per enemy index
+    std::vector<int> prev;     // previous one, -1 at the head, UNLINKED if in no cell
+
+    void reset(int width, int height) {
+        w = width; h = height;
+        head.assign((size_t)w * h, -1);
+        next.clear();
+        prev.clear();
+    }
+
+    // preallocate links for n enemy slots
+    void reserve(size_t n) {
+        if (next.size() < n) {
+            next.resize(n, -1);
+            prev.resize(n, UNLINKED);
+        }
+    }
+
+    bool inside(int x, int y) const { return x >= 0 && x < w && y >= 0 && y < h; }
+
+    void insert(int idx, int x, int y) {
+        if ((int)next.size() <= idx) reserve(idx + 1);
+        if (!inside(x, y)) return;
+        int &cell = head[y * w + x];
+        next[idx] = cell;
+        prev[idx] = -1;
+        if (cell != -1) prev[cell] = idx;
+        cell = idx;
+    }
+
+    void remove(int idx, int x, int y) {
+        if (!inside(x, y) || (int)prev.size() <= idx || prev[idx] == UNLINKED) return;
+        int &cell = head[y * w + x];
+        if (prev[idx] == -1) {
+            if (cell != idx) return;               // linked in another cell
+            cell = next[idx];
+        } else {
+            next[prev[idx]] = next[idx];
+        }
+        if (next[idx] != -1) prev[next[idx]] = prev[idx];
+        next[idx] = -1;
+        prev[idx] = UNLINKED;
+    }
+
+    void move(int idx, int ox, int oy, int nx, int ny) {
+        remove(idx, ox, oy);
+        insert(idx, nx, ny);
+    }
+
+    // first enemy on (x, y), or -1
+    int at(int x, int y) const {
+        return inside(x, y) ? head[y * w + x] : -1;
+    }
+};
+
+// ---------- Launcher battery ----------
+// One bit per launcher (1 = loaded) in atomic 64-bit words, so any k works.
+// Firing clears the lowest set bit and reloading sets a clear bit, each with
+// a CAS on a single word: neither side takes a lock or waits for the other.
+class LauncherBattery {
+    std::vector<std::atomic<uint64_t>> words;
+    int k = 0;
+
+    // bits of word w that stand for real launchers
+    uint64_t validMask(int w) const {
+        int bits = std::min(64, k - w * 64);
+        return bits == 64 ? ~0ull : ((1ull << bits) - 1);
+    }
+
+public:
+    void reset(int launchers, bool loaded) {
+        k = launchers;
+        std::vector<std::atomic<uint64_t>>((k + 63) / 64).swap(words);
+        for (int w = 0; w < (int)words.size(); ++w) words[w] = loaded ? validMask(w) : 0;
+    }
+
+    int size() const { return k; }
+
+    // take the first loaded launcher; its index, or -1 if the battery is empty
+    int fire() {
+        for (int w = 0; w < (int)words.size(); ++w) {
+            uint64_t v = words[w].load(std::memory_order_relaxed);
+            while (v) {
+                int bit = __builtin_ctzll(v);
+                if (words[w].compare_exchange_weak(v, v & ~(1ull << bit), std::memory_order_acq_rel))
+                    return w * 64 + bit;
+            }
+        }
+        return -1;
+    }
+
+    // put a rocket in launcher i; false if it was already loaded
+    bool load(int i) {
+        std::atomic<uint64_t>& word = words[i / 64];
+        uint64_t bit = 1ull << (i % 64);
+        uint64_t v = word.load(std::memory_order_relaxed);
+        while (!(v & bit)) {
+            if (word.compare_exchange_weak(v, v | bit, std::memory_order_acq_rel)) return true;
+        }
+        return false;
+    }
+
+    bool loaded(int i) const { return words[i / 64].load(std::memory_order_acquire) >> (i % 64) & 1; }
+    bool any() const {
+        for (const auto& w : words) if (w.load(std::memory_order_acquire)) return true;
+        return false;
+    }
+};
+
+// A launcher emptied by a shot, waiting for a loader.
+struct ReloadJob {
+    int launcher;
+    int64_t emptiedMs;         // game clock
+};
+
+// FIFO of reload jobs with room for the whole battery (a launcher is queued
+// at most once: only a shot empties it, only a loader refills it).
+// Not synchronized; guarded by batteryMutex.
+struct ReloadQueue {
+    std::vector<ReloadJob> ring;
+    size_t head = 0, count = 0;
+
+    void reset(int k) { ring.assign(k, ReloadJob{-1, 0}); head = count = 0; }
+    bool empty() const { return count == 0; }
+    void push(const ReloadJob& j) { ring[(head + count++) % ring.size()] = j; }
+    ReloadJob pop() {
+        ReloadJob j = ring[head];
+        head = (head + 1) % ring.size();
+        --count;
+        return j;
+    }
+};
+
+// ---------- Frame buffer ----------
+// Shadow copy of the game window. A frame is composed into `next`, compared
+// cell by cell with what is already on the terminal (`shown`) and only the
+// cells that differ are written, so the ground, the border and every other
+// unchanged cell go out once instead of every frame.
+struct FrameBuffer {
+    int w = 0, h = 0;
+    std::vector<chtype> shown;
+    std::vector<chtype> next;
+
+    void reset(int width, int height) {
+        w = width; h = height;
+        shown.assign((size_t)w * h, 0);    // nothing matches: the first flush writes every cell
+        next.assign((size_t)w * h, ' ');
+    }
+
+    void clear() { std::fill(next.begin(), next.end(), (chtype)' '); }
+
+    void put(int x, int y, chtype c) {
+        if (x >= 0 && x < w && y >= 0 && y < h) next[y * w + x] = c;
+    }
+
+    // printf into the frame, clipped at the right edge. One cell per byte,
+    // except the UTF-8 degree sign used by the aim text, which becomes ACS_DEGREE
+    // so cell columns keep matching terminal columns.
+    void print(int x, int y, const char* fmt, ...) {
+        char buf[256];
+        va_list ap;
+        va_start(ap, fmt);
+        vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        for (const char* p = buf; *p; ++p, ++x) {
+            if (p[0] == '\xC2' && p[1] == '\xB0') { put(x, y, ACS_DEGREE); ++p; continue; }
+            put(x, y, (unsigned char)*p);
+        }
+    }
+
+    void drawBox() {
+        for (int x = 1; x < w-1; ++x) { put(x, 0, ACS_HLINE); put(x, h-1, ACS_HLINE); }
+        for (int y = 1; y < h-1; ++y) { put(0, y, ACS_VLINE); put(w-1, y, ACS_VLINE); }
+        put(0, 0, ACS_ULCORNER);   put(w-1, 0, ACS_URCORNER);
+        put(0, h-1, ACS_LLCORNER); put(w-1, h-1, ACS_LRCORNER);
+    }
+
+    // write the changed cells to win; returns how many were written
+    int flush(WINDOW* win) {
+        int written = 0;
+        for (size_t i = 0; i < next.size(); ++i) {
+            if (next[i] == shown[i]) continue;
+            mvwaddch(win, i / w, i % w, next[i]);
+            shown[i] = next[i];
+            ++written;
+        }
+        wrefresh(win);
+        return written;
+    }
+};
+
+// text drawn over the frame, e.g. "No rockets available!" or the final result
+struct ScreenMessage {
+    int x, y;
+    std::string text;
+    bool sticky;               // stays until the end of the game
+    std::chrono::steady_clock::time_point until;
+};
+
+// ---------- World snapshot ----------
+struct Cell { int x, y; };
+
+// Everything the renderer needs from one simulation step, copied out so the
+// render thread never touches the live lists.
+struct WorldSnapshot {
+    int destroyed = 0, ground = 0, spawned = 0;
+    size_t enemyLive = 0, enemySlots = 0, rocketLive = 0, rocketSlots = 0;
+    std::vector<char> battery;     // 1 = launcher loaded
+    Aim aim = AIM_UP;
+    std::vector<Cell> enemies;
+    std::vector<Cell> rockets;
+};
+
+// Lock-free single-producer / single-consumer handoff of the latest value.
+// The producer fills writeBuffer() and publishes it; the consumer picks up
+// the newest published buffer with update(). Neither side ever waits, and
+// buffers are recycled so their vectors keep their capacity.
+template <typename T>
+class TripleBuffer {
+    static const int FRESH = 4;    // set in `middle` when it holds an unread value
+    T bufs[3];
+    std::atomic<int> middle{1};
+    int back = 0;                  // producer-owned
+    int front = 2;                 // consumer-owned
+
+public:
+    T& writeBuffer() { return bufs[back]; }
+    void publish() { back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & 3; }
+
+    // true if a newer value was picked up
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+    const T& readBuffer() const { return bufs[front]; }
+};
+
+// ---------- SPSC ring ----------
+// Bounded lock-free queue between exactly one producer and one consumer
+// thread. Each side owns one index and only reads the other's, so neither
+// ever waits on the other; push fails instead of blocking when full.
+template <typename T, size_t N>
+class SpscRing {
+    static_assert((N & (N - 1)) == 0, "capacity must be a power of two");
+    T items[N];
+    std::atomic<size_t> head{0};   // next to pop (consumer-owned)
+    std::atomic<size_t> tail{0};   // next to push (producer-owned)
+
+public:
+    bool push(const T& v) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) == N) return false;
+        items[t & (N - 1)] = v;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // oldest item, or nullptr if empty; stays queued until pop()
+    const T* front() {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) return nullptr;
+        return &items[h & (N - 1)];
+    }
+    void pop() { head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+    size_t size() const {
+        return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+    }
+};
+
+// ---------- Clock ----------
+// Every game timer goes through a GameClock, so the same game can run on
+// the wall clock or on virtual time. Threads that sleep on the clock must be
+// started with spawn() (or attach() themselves), so the virtual clock knows
+// who it is waiting for.
+class GameClock {
+public:
+    virtual ~GameClock() {}
+    virtual int64_t nowMs() = 0;                  // ms since the clock started
+    virtual void sleepUntil(int64_t ms) = 0;
+    virtual void sleepFor(int ms) { sleepUntil(nowMs() + ms); }
+    // condition wait bounded by ms (< 0: no bound); callers re-check their predicate
+    virtual void wait(pthread_cond_t* cv, pthread_mutex_t* m, int ms) = 0;
+    // signal (all: broadcast) cv for threads in wait(); call with the waiters' mutex held
+    virtual void notify(pthread_cond_t* cv, bool all) = 0;
+    // stackBytes 0: the default pthread stack; false if the thread could not be created
+    virtual bool spawn(pthread_t* tid, void* (*fn)(void*), void* arg, size_t stackBytes = 0) = 0;
+    virtual void attach() {}                      // calling thread joins the clock
+    virtual void detach() {}
+    // spawn() in two halves, to hand work to a thread that already exists
+    // (worker pools): the submitter calls admit() where it would spawn, and
+    // the thread calls enter(ticket) before the work and detach() after it;
+    // release(ticket) gives back a ticket no thread will enter
+    virtual void* admit() { return nullptr; }
+    virtual void enter(void*) {}
+    virtual void release(void*) {}
+    // game over: wake every thread sleeping on wall time now, and make later
+    // sleeps return at once, so shutdown does not wait out the longest timer
+    virtual void cancelSleeps() = 0;
+};
+
+// pthread_create with the given stack size (0: the default stack); false if it failed
+bool startThread(pthread_t* tid, void* (*fn)(void*), void* arg, size_t stackBytes) {
+    if (!stackBytes) return pthread_create(tid, nullptr, fn, arg) == 0;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, stackBytes);
+    int err = pthread_create(tid, &attr, fn, arg);
+    pthread_attr_destroy(&attr);
+    return err == 0;
+}
+
+// pthread_cond_wait bounded by a wall-clock timeout (ms < 0: unbounded)
+void timedCondWait(pthread_cond_t* cv, pthread_mutex_t* m, int ms) {
+    if (ms < 0) { pthread_cond_wait(cv, m); return; }
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += ms / 1000;
+    ts.tv_nsec += (long)(ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) { ts.tv_sec++; ts.tv_nsec -= 1000000000; }
+    pthread_cond_timedwait(cv, m, &ts);
+}
+
+// A stop flag timed sleeps can wait on: raise() wakes every sleeper at once
+// and makes later sleeps return immediately.
+class StopSignal {
+    pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t cv;
+    bool raised = false;
+
+public:
+    StopSignal() {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);     // same clock as steady_clock
+        pthread_cond_init(&cv, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+
+    // false if woken by raise()
+    bool sleepUntil(std::chrono::steady_clock::time_point t) {
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(t.time_since_epoch()).count();
+        timespec ts;
+        ts.tv_sec = ns / 1000000000;
+        ts.tv_nsec = ns % 1000000000;
+        pthread_mutex_lock(&m);
+        while (!raised && std::chrono::steady_clock::now() < t)
+            pthread_cond_timedwait(&cv, &m, &ts);
+        bool ok = !raised;
+        pthread_mutex_unlock(&m);
+        return ok;
+    }
+
+    void raise() {
+        pthread_mutex_lock(&m);
+        raised = true;
+        pthread_cond_broadcast(&cv);
+        pthread_mutex_unlock(&m);
+    }
+
+    void reset() {
+        pthread_mutex_lock(&m);
+        raised = false;
+        pthread_mutex_unlock(&m);
+    }
+};
+
+class RealClock : public GameClock {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    StopSignal stop;
+public:
+    int64_t nowMs() override {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+    void sleepUntil(int64_t ms) override {
+        stop.sleepUntil(start + std::chrono::milliseconds(ms));
+    }
+    void sleepFor(int ms) override {
+        stop.sleepUntil(std::chrono::steady_clock::now() + std::chrono::milliseconds(ms));
+    }
+    void cancelSleeps() override { stop.raise(); }
+    void resetSleeps() { stop.reset(); }
+    // wall-clock instant of game time ms
+    std::chrono::steady_clock::time_point at(int64_t ms) const {
+        return start + std::chrono::milliseconds(ms);
+    }
+    void wait(pthread_cond_t* cv, pthread_mutex_t* m, int ms) override {
+        timedCondWait(cv, m, ms);
+    }
+    void notify(pthread_cond_t* cv, bool all) override {
+        if (all) pthread_cond_broadcast(cv);
+        else pthread_cond_signal(cv);
+    }
+    bool spawn(pthread_t* tid, void* (*fn)(void*), void* arg, size_t stackBytes = 0) override {
+        return startThread(tid, fn, arg, stackBytes);
+    }
+};
+
+// Discrete-event time: only one attached thread runs at a time. When it
+// sleeps, the sleeper with the earliest (wake time, attach order) is resumed
+// and virtual time jumps to its wake time, so the interleaving is the same on
+// every run. With speed > 0 each jump is also paced to speed x wall time;
+// with speed 0 a game runs as fast as the CPU allows.
+// Threads that are not attached (keyboard input) sleep the wall-clock
+// equivalent of the virtual interval. An attached thread in wait() is parked
+// with no wake time (or its timeout) until notify() makes it runnable at the
+// current virtual time, so idle waiters cost nothing while time advances.
+class VirtualClock : public GameClock {
+    struct Participant {
+        int id;
+        int64_t wake = 0;
+        bool granted = false;
+        pthread_cond_t* waitingOn = nullptr;       // condition it is parked on in wait()
+        pthread_cond_t cv = PTHREAD_COND_INITIALIZER;
+    };
+    struct Start {
+        VirtualClock* clock;
+        Participant* p;
+        void* (*fn)(void*);
+        void* arg;
+    };
+
+    pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+    int64_t now = 0;
+    int running = 0;           // attached threads not sleeping (+1 while pacing)
+    int nextId = 0;
+    double speed = 0;
+    std::chrono::steady_clock::time_point origin;  // wall time of virtual 0, set on first enroll
+    StopSignal pacing;                              // raised: stop pacing to the wall clock
+    bool unpaced = false;                           // pacing was cut short: run the rest unpaced
+    std::set<std::pair<int64_t, int>> sleepers;
+    std::map<int, Participant*> byId;
+    std::map<pthread_cond_t*, std::deque<Participant*>> waiters;   // in wait(), by condition
+    static thread_local Participant* self;
+
+    std::chrono::steady_clock::time_point wallAt(int64_t ms) const {
+        return origin + std::chrono::microseconds((int64_t)(ms * 1000 / speed));
+    }
+
+    // resume the next sleeper once nobody is running; m held
+    void dispatch() {
+        while (running == 0 && !sleepers.empty()) {
+            auto first = sleepers.begin();
+            if (speed > 0 && !unpaced && std::chrono::steady_clock::now() < wallAt(first->first)) {
+                // hold the turn while waiting for the wall clock to catch up;
+                // re-pick afterwards in case an earlier thread was spawned meanwhile.
+                // Once sleeps are cancelled the remaining virtual time runs unpaced.
+                auto until = wallAt(first->first);
+                running++;
+                pthread_mutex_unlock(&m);
+                bool paced = pacing.sleepUntil(until);
+                pthread_mutex_lock(&m);
+                if (!paced) unpaced = true;
+                running--;
+                continue;
+            }
+            Participant* p = byId[first->second];
+            now = first->first;
+            sleepers.erase(first);
+            if (p->waitingOn) unwait(p);            // a bounded wait timed out
+            running++;
+            p->granted = true;
+            pthread_cond_signal(&p->cv);
+            return;
+        }
+    }
+
+    // take p off the waiters of its condition; m held
+    void unwait(Participant* p) {
+        std::deque<Participant*>& q = waiters[p->waitingOn];
+        q.erase(std::find(q.begin(), q.end(), p));
+        p->waitingOn = nullptr;
+    }
+
+    // park until dispatched; m held
+    void park(Participant* p) {
+        while (!p->granted) pthread_cond_wait(&p->cv, &m);
+        p->granted = false;
+    }
+
+    Participant* enroll() {
+        if (nextId == 0) origin = std::chrono::steady_clock::now();
+        Participant* p = new Participant;
+        p->id = nextId++;
+        byId[p->id] = p;
+        return p;
+    }
+
+    static void* trampoline(void* a) {
+        Start st = *(Start*)a;
+        delete (Start*)a;
+        st.clock->enter(st.p);
+        void* r = st.fn(st.arg);
+        st.clock->detach();
+        return r;
+    }
+
+public:
+    // speed x wall time; 0 = unpaced. Set before any thread attaches.
+    void setSpeed(double s) { speed = s; }
+
+    int64_t nowMs() override {
+        pthread_mutex_lock(&m);
+        int64_t t = now;
+        pthread_mutex_unlock(&m);
+        return t;
+    }
+
+    void sleepUntil(int64_t ms) override {
+        Participant* p = self;
+        if (!p) {
+            // not attached: wall-clock equivalent
+            if (speed > 0 && nextId > 0) pacing.sleepUntil(wallAt(ms));
+            else std::this_thread::yield();
+            return;
+        }
+        pthread_mutex_lock(&m);
+        p->wake = std::max(ms, now);
+        sleepers.insert({p->wake, p->id});
+        running--;
+        dispatch();
+        park(p);
+        pthread_mutex_unlock(&m);
+    }
+
+    // an attached thread is registered as a waiter before it lets go of mx,
+    // so a notify() made under mx cannot slip in between and be lost
+    void wait(pthread_cond_t* cv, pthread_mutex_t* mx, int ms) override {
+        Participant* p = self;
+        if (!p) {
+            timedCondWait(cv, mx, ms < 0 || speed <= 0 ? ms : (int)(ms / speed));
+            return;
+        }
+        pthread_mutex_lock(&m);
+        p->waitingOn = cv;
+        waiters[cv].push_back(p);
+        if (ms >= 0) {
+            p->wake = now + ms;
+            sleepers.insert({p->wake, p->id});
+        }
+        running--;
+        pthread_mutex_unlock(mx);
+        dispatch();
+        park(p);
+        pthread_mutex_unlock(&m);
+        pthread_mutex_lock(mx);
+    }
+
+    // notified waiters are queued at the current time behind everyone already due
+    void notify(pthread_cond_t* cv, bool all) override {
+        pthread_mutex_lock(&m);
+        auto it = waiters.find(cv);
+        while (it != waiters.end() && !it->second.empty()) {
+            Participant* p = it->second.front();
+            it->second.pop_front();
+            p->waitingOn = nullptr;
+            sleepers.erase({p->wake, p->id});
+            p->wake = now;
+            sleepers.insert({p->wake, p->id});
+            if (!all) break;
+        }
+        dispatch();
+        pthread_mutex_unlock(&m);
+        // threads that are not attached wait on cv itself
+        if (all) pthread_cond_broadcast(cv);
+        else pthread_cond_signal(cv);
+    }
+
+    // the new thread is queued at the current time behind everyone already due
+    bool spawn(pthread_t* tid, void* (*fn)(void*), void* arg, size_t stackBytes = 0) override {
+        Start* st = new Start{this, (Participant*)admit(), fn, arg};
+        if (startThread(tid, trampoline, st, stackBytes)) return true;
+        release(st->p);
+        delete st;
+        return false;
+    }
+
+    void* admit() override {
+        pthread_mutex_lock(&m);
+        Participant* p = enroll();
+        p->wake = now;
+        sleepers.insert({p->wake, p->id});
+        dispatch();
+        pthread_mutex_unlock(&m);
+        return p;
+    }
+
+    // run as the admitted participant, from its first turn on
+    void enter(void* ticket) override {
+        Participant* p = (Participant*)ticket;
+        self = p;
+        pthread_mutex_lock(&m);
+        park(p);
+        pthread_mutex_unlock(&m);
+    }
+
+    // the ticket may already hold the turn: hand it on
+    void release(void* ticket) override {
+        Participant* p = (Participant*)ticket;
+        pthread_mutex_lock(&m);
+        if (p->granted) running--;
+        else sleepers.erase({p->wake, p->id});
+        byId.erase(p->id);
+        dispatch();
+        pthread_mutex_unlock(&m);
+        delete p;
+    }
+
+    void cancelSleeps() override { pacing.raise(); }
+
+    void attach() override {
+        pthread_mutex_lock(&m);
+        self = enroll();
+        running++;
+        pthread_mutex_unlock(&m);
+    }
+
+    void detach() override {
+        Participant* p = self;
+        if (!p) return;
+        pthread_mutex_lock(&m);
+        byId.erase(p->id);
+        running--;
+        dispatch();
+        pthread_mutex_unlock(&m);
+        self = nullptr;
+        delete p;
+    }
+};
+thread_local VirtualClock::Participant* VirtualClock::self = nullptr;
+
+// ---------- Instrumentation ----------
+int64_t steadyNowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void atomicMax(std::atomic<uint64_t>& a, uint64_t v) {
+    uint64_t cur = a.load(std::memory_order_relaxed);
+    while (v > cur && !a.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+
+// Log-linear latency histogram in the spirit of HdrHistogram: values (ns)
+// fall into 8 sub-buckets per power of two, so every percentile is within
+// 12.5% of the truth over the whole 64-bit range. record() is a few relaxed
+// atomic adds, safe from any thread; readers walk the buckets.
+class LatencyHistogram {
+    static const int SUB_BITS = 3;
+    static const int SUB = 1 << SUB_BITS;
+    static const int BUCKETS = (64 - SUB_BITS + 1) * SUB;
+
+    std::atomic<uint64_t> counts[BUCKETS];
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> high{0};
+
+    static int bucketOf(uint64_t v) {
+        if (v < SUB) return (int)v;
+        int shift = 63 - __builtin_clzll(v) - SUB_BITS;
+        return (shift + 1) * SUB + (int)((v >> shift) & (SUB - 1));
+    }
+    // largest value that lands in bucket b
+    static uint64_t bucketTop(int b) {
+        if (b < SUB) return b;
+        int shift = b / SUB - 1;
+        return ((uint64_t)(SUB + b % SUB) << shift) + ((1ull << shift) - 1);
+    }
+
+public:
+    LatencyHistogram() { for (auto& c : counts) c.store(0, std::memory_order_relaxed); }
+
+    void record(int64_t ns) {
+        uint64_t v = ns < 0 ? 0 : (uint64_t)ns;
+        counts[bucketOf(v)].fetch_add(1, std::memory_order_relaxed);
+        total.fetch_add(1, std::memory_order_relaxed);
+        sum.fetch_add(v, std::memory_order_relaxed);
+        atomicMax(high, v);
+    }
+
+    uint64_t count() const { return total.load(std::memory_order_relaxed); }
+    uint64_t max() const { return high.load(std::memory_order_relaxed); }
+    uint64_t mean() const { uint64_t n = count(); return n ? sum.load(std::memory_order_relaxed) / n : 0; }
+
+    // value at or below which a fraction q (0..1) of the samples fall
+    uint64_t percentile(double q) const {
+        uint64_t n = count();
+        if (n == 0) return 0;
+        uint64_t want = (uint64_t)std::ceil(q * n), seen = 0;
+        if (want == 0) want = 1;
+        for (int b = 0; b < BUCKETS; ++b) {
+            seen += counts[b].load(std::memory_order_relaxed);
+            if (seen >= want) return std::min(bucketTop(b), max());
+        }
+        return max();
+    }
+};
+
+// pthread mutex that profiles itself: every lock() feeds a wait histogram
+// (for the overlay) and the stats of its call site (acquisitions, wait and
+// hold time, for the --stats report). Call sites are told apart by the
+// caller's function and line, which the default arguments of lock() pick up,
+// so callers just write m.lock().
+class GameMutex {
+public:
+    struct Site {
+        std::atomic<const char*> func{nullptr};   // nullptr = free slot
+        std::atomic<int> line{0};                 // stored right after func is claimed
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> waitNs{0}, maxWaitNs{0};
+        std::atomic<uint64_t> holdNs{0}, maxHoldNs{0};
+    };
+    static const int MAX_SITES = 32;
+    static const int OTHER_SITE = MAX_SITES - 1;  // never claimed: every site past the table
+
+private:
+    pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+    Site sites[MAX_SITES];
+    Site* holder = nullptr;        // owner only
+    int64_t heldSince = 0;         // owner only
+
+    // a call site is (function, line): the same line number in two functions
+    // gets two slots
+    Site* siteFor(const char* func, int line) {
+        for (int i = 0; i < OTHER_SITE; ++i) {
+            Site& s = sites[i];
+            const char* f = s.func.load(std::memory_order_acquire);
+            if (!f && s.func.compare_exchange_strong(f, func, std::memory_order_acq_rel)) {
+                s.line.store(line, std::memory_order_release);
+                return &s;
+            }
+            // f is the owner's function now; its line follows at once, unless
+            // the owner was preempted in between: yield so it can run
+            int l;
+            while ((l = s.line.load(std::memory_order_acquire)) == 0) sched_yield();
+            if (l == line && (f == func || strcmp(f, func) == 0)) return &s;
+        }
+        return &sites[OTHER_SITE];
+    }
+
+    void endHold() {
+        uint64_t held = steadyNowNs() - heldSince;
+        holder->holdNs.fetch_add(held, std::memory_order_relaxed);
+        atomicMax(holder->maxHoldNs, held);
+    }
+
+public:
+    const char* name;
+    LatencyHistogram waits;
+
+    explicit GameMutex(const char* n) : name(n) {}
+
+    void lock(const char* func = __builtin_FUNCTION(), int line = __builtin_LINE()) {
+        Site* s = siteFor(func, line);
+        uint64_t wait = 0;
+        if (pthread_mutex_trylock(&m) == 0) {
+            heldSince = steadyNowNs();
+        } else {
+            int64_t t0 = steadyNowNs();
+            pthread_mutex_lock(&m);
+            heldSince = steadyNowNs();
+            wait = heldSince - t0;
+        }
+        holder = s;
+        waits.record(wait);
+        s->count.fetch_add(1, std::memory_order_relaxed);
+        s->waitNs.fetch_add(wait, std::memory_order_relaxed);
+        atomicMax(s->maxWaitNs, wait);
+    }
+
+    void unlock() {
+        endHold();
+        pthread_mutex_unlock(&m);
+    }
+
+    // condition wait on the game clock; the time asleep does not count as held
+    void wait(GameClock* clock, pthread_cond_t* cv, int ms) {
+        Site* s = holder;
+        endHold();
+        clock->wait(cv, &m, ms);
+        holder = s;
+        heldSince = steadyNowNs();
+    }
+
+    const Site* siteTable() const { return sites; }
+};
+
+// "850ns", "12.3us", "4.5ms", "1.20s"
+const char* formatNs(uint64_t ns, char* buf, size_t n) {
+    if (ns < 1000) snprintf(buf, n, "%lluns", (unsigned long long)ns);
+    else if (ns < 1000000) snprintf(buf, n, "%.1fus", ns / 1e3);
+    else if (ns < 1000000000) snprintf(buf, n, "%.1fms", ns / 1e6);
+    else snprintf(buf, n, "%.2fs", ns / 1e9);
+    return buf;
+}
+
+// ---------- Tracing ----------
+// --trace FILE writes a Chrome Trace Event JSON file (chrome://tracing,
+// ui.perfetto.dev). Each thread appends to its own buffer, so tracing adds no
+// locking to the game; buffers are registered once per thread and written
+// out after every thread has been joined. Timestamps are wall time.
+struct TraceEvent {
+    const char* name;
+    char ph;                   // 'i' instant, 'X' complete
+    int64_t tsNs, durNs;
+    const char* argName;       // nullptr: no argument
+    int64_t arg;
+};
+
+struct TraceThread {
+    int tid;
+    std::string name;
+    std::vector<TraceEvent> events;
+};
+
+bool tracing = false;
+int64_t traceStartNs = 0;
+std::vector<std::unique_ptr<TraceThread>> traceThreads;    // guarded by traceMutex
+pthread_mutex_t traceMutex = PTHREAD_MUTEX_INITIALIZER;
+thread_local TraceThread* traceSelf = nullptr;
+
+// name the calling thread in the trace (registers its buffer)
+void traceThread(const char* fmt, ...) {
+    if (!tracing) return;
+    char name[64];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(name, sizeof(name), fmt, ap);
+    va_end(ap);
+    if (traceSelf) { traceSelf->name = name; return; }
+
+    TraceThread* t = new TraceThread;
+    t->name = name;
+    t->events.reserve(256);
+    pthread_mutex_lock(&traceMutex);
+    t->tid = (int)traceThreads.size() + 1;
+    traceThreads.emplace_back(t);
+    pthread_mutex_unlock(&traceMutex);
+    traceSelf = t;
+}
+
+// Pool workers run many entities on one row: the row keeps the worker's name
+// and each job span carries the kind and id of the entity it ran.
+thread_local bool traceInPool = false;
+thread_local const char* traceJobKind = nullptr;   // nullptr: no entity yet
+thread_local int traceJobId = 0;
+
+// name the entity running on the calling thread: its own row on a thread of
+// its own, the current job's span argument on a pool worker
+void traceEntity(const char* kind, int id) {
+    if (!tracing) return;
+    if (!traceInPool) {
+        traceThread("%s %d", kind, id);
+        return;
+    }
+    traceJobKind = kind;
+    traceJobId = id;
+}
+
+void traceAppend(const TraceEvent& ev) {
+    if (!traceSelf) traceThread("thread");
+    traceSelf->events.push_back(ev);
+}
+
+// start of a complete event; 0 when not tracing
+int64_t traceBegin() { return tracing ? steadyNowNs() : 0; }
+
+void traceEnd(const char* name, int64_t beginNs, const char* argName = nullptr, int64_t arg = 0) {
+    if (!tracing) return;
+    int64_t now = steadyNowNs();
+    traceAppend(TraceEvent{name, 'X', beginNs - traceStartNs, now - beginNs, argName, arg});
+}
+
+void traceInstant(const char* name, const char* argName = nullptr, int64_t arg = 0) {
+    if (!tracing) return;
+    traceAppend(TraceEvent{name, 'i', steadyNowNs() - traceStartNs, 0, argName, arg});
+}
+
+bool writeTrace(const char* path) {
+    FILE* f = fopen(path, "w");
+    if (!f) return false;
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto& t : traceThreads) {
+        fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+                first ? "" : ",\n", t->tid, t->name.c_str());
+        first = false;
+        for (const TraceEvent& ev : t->events) {
+            fprintf(f, ",\n{\"name\":\"%s\",\"ph\":\"%c\",\"pid\":1,\"tid\":%d,\"ts\":%.3f",
+                    ev.name, ev.ph, t->tid, ev.tsNs / 1e3);
+            if (ev.ph == 'X') fprintf(f, ",\"dur\":%.3f", ev.durNs / 1e3);
+            else fprintf(f, ",\"s\":\"t\"");
+            if (ev.argName) fprintf(f, ",\"args\":{\"%s\":%lld}", ev.argName, (long long)ev.arg);
+            fprintf(f, "}");
+        }
+    }
+    fprintf(f, "\n]}\n");
+    return fclose(f) == 0;
+}
+
+// ---------- Work-stealing pool ----------
+// Runs the tasks of one parallel phase, run(n, fn) calling fn(task, worker)
+// for every task in [0, n), on the calling thread (worker 0) plus workers-1
+// helper threads. Each worker starts with a contiguous block of tasks kept as
+// [lo, hi) in one atomic word: the owner takes from lo, and a worker that ran
+// out steals the upper half of a victim's remaining block from hi. run
+// returns only after every task has finished, so the caller can merge the
+// results in task order no matter which worker ran which task.
+class TaskPool {
+public:
+    struct WorkerStats {
+        int64_t busyNs = 0;    // time inside tasks
+        int64_t tasks = 0;
+        int64_t steals = 0;
+    };
+
+    // workers - 1 helper threads (fewer if the system refuses more); stats start from zero
+    void start(int workers) {
+        count = std::max(1, workers);
+        slots.reset(new Slot[count]);
+        helpers.assign(count - 1, HelperArg());
+        tids.assign(count - 1, pthread_t());
+        stopping = false;
+        runNs = 0;
+        for (int w = 1; w < count; ++w) {
+            helpers[w-1] = HelperArg{this, w, generation};
+            if (pthread_create(&tids[w-1], nullptr, helperMain, &helpers[w-1]) != 0) {
+                // out of threads: share the phases among the helpers that did start
+                count = w;
+                tids.resize(w - 1);
+                break;
+            }
+        }
+    }
+
+    void stop() {
+        pthread_mutex_lock(&m);
+        stopping = true;
+        pthread_cond_broadcast(&wake);
+        pthread_mutex_unlock(&m);
+        for (pthread_t t : tids) pthread_join(t, nullptr);
+        tids.clear();
+    }
+
+    template <typename F>
+    void run(int n, F &f) {
+        if (n <= 0) return;
+        int64_t t0 = steadyNowNs();
+        if (count <= 1 || n == 1) {
+            // nothing to share: run inline and spare the helpers a wakeup
+            for (int t = 0; t < n; ++t) f(t, 0);
+            if (count > 0) {
+                int64_t ns = steadyNowNs() - t0;
+                slots[0].stats.busyNs += ns;
+                slots[0].stats.tasks += n;
+                runNs += ns;
+            }
+            return;
+        }
+
+        fn = [](void* c, int t, int w) { (*(F*)c)(t, w); };
+        ctx = &f;
+        for (int w = 0; w < count; ++w)
+            slots[w].range.store(pack((uint32_t)((int64_t)n * w / count), (uint32_t)((int64_t)n * (w + 1) / count)));
+
+        pthread_mutex_lock(&m);
+        ++generation;
+        active = count - 1;
+        pthread_cond_broadcast(&wake);
+        pthread_mutex_unlock(&m);
+
+        work(0);
+
+        // a helper leaves the phase only once nothing is left to take or steal
+        pthread_mutex_lock(&m);
+        while (active > 0) pthread_cond_wait(&done, &m);
+        pthread_mutex_unlock(&m);
+        runNs += steadyNowNs() - t0;
+    }
+
+    int size() const { return count; }
+    const WorkerStats& stats(int w) const { return slots[w].stats; }
+    int64_t wallNs() const { return runNs; }     // time spent inside run()
+
+private:
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> range{0};     // hi << 32 | lo
+        WorkerStats stats;                  // written by its worker only
+    };
+    struct HelperArg {
+        TaskPool* pool;
+        int w;
+        uint64_t seen;             // generation at start: phases before it are not ours
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    int count = 0;
+    std::vector<HelperArg> helpers;
+    std::vector<pthread_t> tids;
+    int64_t runNs = 0;
+
+    void (*fn)(void*, int, int) = nullptr;     // the phase being run
+    void* ctx = nullptr;
+
+    pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+    pthread_cond_t done = PTHREAD_COND_INITIALIZER;
+    uint64_t generation = 0;       // guarded by m
+    int active = 0;                // helpers still in the phase
+    bool stopping = false;
+
+    static uint64_t pack(uint32_t lo, uint32_t hi) { return (uint64_t)hi << 32 | lo; }
+
+    // next task for worker w: its own block first, else half of a victim's
+    bool next(int w, int &task) {
+        std::atomic<uint64_t> &mine = slots[w].range;
+        uint64_t r = mine.load();
+        while ((uint32_t)r < (uint32_t)(r >> 32)) {
+            if (mine.compare_exchange_weak(r, r + 1)) {
+                task = (int)(uint32_t)r;
+                return true;
+            }
+        }
+        for (int k = 1; k < count; ++k) {
+            std::atomic<uint64_t> &victim = slots[(w + k) % count].range;
+            uint64_t v = victim.load();
+            while (true) {
+                uint32_t lo = (uint32_t)v, hi = (uint32_t)(v >> 32);
+                if (lo >= hi) break;
+                uint32_t mid = hi - (hi - lo + 1) / 2;
+                if (victim.compare_exchange_weak(v, pack(lo, mid))) {
+                    // ours is empty, so no thief is competing for it
+                    mine.store(pack(mid + 1, hi));
+                    slots[w].stats.steals++;
+                    task = (int)mid;
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void work(int w) {
+        WorkerStats &st = slots[w].stats;
+        int task;
+        while (next(w, task)) {
+            int64_t t0 = steadyNowNs();
+            fn(ctx, task, w);
+            st.busyNs += steadyNowNs() - t0;
+            st.tasks++;
+        }
+    }
+
+    static void* helperMain(void* arg) {
+        HelperArg a = *(HelperArg*)arg;
+        TaskPool &p = *a.pool;
+        traceThread("worker %d", a.w);
+        uint64_t seen = a.seen;
+        pthread_mutex_lock(&p.m);
+        while (true) {
+            while (!p.stopping && p.generation == seen) pthread_cond_wait(&p.wake, &p.m);
+            if (p.stopping) break;
+            seen = p.generation;
+            pthread_mutex_unlock(&p.m);
+            p.work(a.w);
+            pthread_mutex_lock(&p.m);
+            if (--p.active == 0) pthread_cond_signal(&p.done);
+        }
+        pthread_mutex_unlock(&p.m);
+        return nullptr;
+    }
+};
+
+// ---------- Entity worker pool ----------
+// Pre-started threads with small stacks that run the enemy / rocket bodies
+// of --entity-threads, so an entity costs a queue push instead of a
+// pthread_create and a fresh 8 MB stack reservation. A worker runs one
+// entity until it dies, then takes the next. Jobs are admitted on the game
+// clock where spawn() would have started a thread, so a virtual-time game
+// interleaves exactly as with a thread per entity. A job that finds every
+// worker taken gets a thread of its own (overflow), on the same small stack
+// as the workers; those threads post themselves to a completion queue when
+// done and a reaper thread joins them right away, so threads never pile up
+// behind dead entities. When the system refuses more threads the pool keeps
+// the workers it got, and a job whose overflow thread cannot be created is
+// refused: the submitter drops the entity, as with an exhausted pool.
+class EntityWorkers {
+public:
+    // false if not even the reaper and one worker could be started
+    bool start(GameClock* c, int workers, size_t stackBytes) {
+        clock = c;
+        count = workers;
+        stack = std::max<size_t>(stackBytes, PTHREAD_STACK_MIN);
+        queue.assign(count, Job());
+        head = queued = busy = 0;
+        stopping = false;
+        args.assign(count, WorkerArg());
+        tids.assign(count, pthread_t());
+        if (!startThread(&reaperTid, reaperMain, this, stack)) {
+            tids.clear();
+            return false;
+        }
+        running = true;
+        for (int w = 0; w < count; ++w) {
+            args[w] = WorkerArg{this, w};
+            if (!startThread(&tids[w], workerMain, &args[w], stack)) {
+                count = w;
+                tids.resize(w);
+                break;
+            }
+        }
+        if (count == 0) {
+            stop();
+            return false;
+        }
+        return true;
+    }
+
+    // run fn(arg) as a new entity; false if no thread could take it (arg is
+    // left to the caller)
+    bool submit(void* (*fn)(void*), void* arg) {
+        pthread_mutex_lock(&m);
+        jobs++;
+        if (busy < count) {
+            busy++;
+            queue[(head + queued++) % count] = Job{fn, arg, clock->admit()};
+            pthread_cond_signal(&work);
+            pthread_mutex_unlock(&m);
+            return true;
+        }
+        Overflow* o = new Overflow{this, fn, arg};
+        pthread_t tid;
+        if (clock->spawn(&tid, overflowMain, o, stack)) {
+            overflows++;
+            overflowLive++;
+            overflowPeak = std::max(overflowPeak, overflowLive);
+            pthread_mutex_unlock(&m);
+            return true;
+        }
+        refusals++;
+        pthread_mutex_unlock(&m);
+        delete o;
+        return false;
+    }
+
+    // wait for the entities still running (they end once gameRunning drops),
+    // then the workers and the reaper
+    void stop() {
+        if (!running) return;
+        running = false;
+        pthread_mutex_lock(&m);
+        stopping = true;
+        pthread_cond_broadcast(&work);
+        pthread_cond_signal(&reap);
+        pthread_mutex_unlock(&m);
+        for (pthread_t t : tids) pthread_join(t, nullptr);
+        pthread_join(reaperTid, nullptr);
+        tids.clear();
+    }
+
+    int size() const { return count; }
+    size_t stackBytes() const { return stack; }
+    int jobCount() const { return jobs; }
+    int overflowCount() const { return overflows; }
+    int overflowPeakCount() const { return overflowPeak; }     // most overflow threads alive at once
+    int refusedCount() const { return refusals; }              // jobs no thread could take
+
+private:
+    struct Job {
+        void* (*fn)(void*);
+        void* arg;
+        void* ticket;          // from clock->admit()
+    };
+    struct WorkerArg {
+        EntityWorkers* pool;
+        int w;
+    };
+    struct Overflow {
+        EntityWorkers* pool;
+        void* (*fn)(void*);
+        void* arg;
+    };
+
+    GameClock* clock = nullptr;
+    int count = 0;
+    size_t stack = 0;
+    std::vector<WorkerArg> args;
+    std::vector<pthread_t> tids;
+    pthread_t reaperTid;
+    bool running = false;      // reaper started, not stopped yet
+
+    pthread_mutex_t m = PTHREAD_MUTEX_INITIALIZER;
+    pthread_cond_t work = PTHREAD_COND_INITIALIZER;
+    std::vector<Job> queue;    // ring of count jobs waiting for a worker; guarded by m
+    int head = 0, queued = 0;
+    int busy = 0;              // workers running or promised a job
+    int jobs = 0;
+    bool stopping = false;
+    pthread_cond_t reap = PTHREAD_COND_INITIALIZER;
+    std::vector<pthread_t> finished;   // overflow threads done running, not joined yet
+    int overflows = 0, overflowLive = 0, overflowPeak = 0;
+    int refusals = 0;
+
+    static void* workerMain(void* a) {
+        WorkerArg wa = *(WorkerArg*)a;
+        EntityWorkers &p = *wa.pool;
+        traceThread("entity worker %d", wa.w);
+        traceInPool = true;
+        pthread_mutex_lock(&p.m);
+        while (true) {
+            while (!p.stopping && p.queued == 0) pthread_cond_wait(&p.work, &p.m);
+            if (p.queued == 0) break;      // stopping, nothing left to run
+            Job j = p.queue[p.head];
+            p.head = (p.head + 1) % p.count;
+            p.queued--;
+            pthread_mutex_unlock(&p.m);
+
+            int64_t t0 = traceBegin();
+            p.clock->enter(j.ticket);
+            j.fn(j.arg);
+            p.clock->detach();
+            traceEnd("job", t0, traceJobKind, traceJobId);
+            traceJobKind = nullptr;
+
+            pthread_mutex_lock(&p.m);
+            p.busy--;
+        }
+        pthread_mutex_unlock(&p.m);
+        return nullptr;
+    }
+
+    static void* overflowMain(void* a) {
+        Overflow o = *(Overflow*)a;
+        delete (Overflow*)a;
+        o.fn(o.arg);
+        EntityWorkers &p = *o.pool;
+        pthread_mutex_lock(&p.m);
+        p.finished.push_back(pthread_self());
+        pthread_cond_signal(&p.reap);
+        pthread_mutex_unlock(&p.m);
+        return nullptr;
+    }
+
+    // joins overflow threads as they finish; ends after the last one once stopping
+    static void* reaperMain(void* a) {
+        EntityWorkers &p = *(EntityWorkers*)a;
+        pthread_mutex_lock(&p.m);
+        while (true) {
+            while (p.finished.empty() && !(p.stopping && p.overflowLive == 0))
+                pthread_cond_wait(&p.reap, &p.m);
+            if (p.finished.empty()) break;
+            pthread_t t = p.finished.back();
+            p.finished.pop_back();
+            pthread_mutex_unlock(&p.m);
+            // it is past the pool's locks, but a virtual clock still detaches
+            // it after it posted itself, so this can wait for that step
+            pthread_join(t, nullptr);
+            pthread_mutex_lock(&p.m);
+            p.overflowLive--;
+        }
+        pthread_mutex_unlock(&p.m);
+        return nullptr;
+    }
+};
+
+// ---------- Record / replay ----------
+// A game is reproduced from its seed, difficulty, screen size, speeds and the
+// player commands together with the simulation tick that applied each of them.
+// File layout (little endian): "AAR2", u32 seed, u8 difficulty (1-3), u8 loaders (0 = 1),
+// u16 width, u16 height, u16 rocket step ms, u16 enemy step ms (0 = the
+// difficulty's), then per command a LEB128 tick delta and a u8 command.
+// "AAR1" files lack the two speeds and play at the defaults.
+struct InputEvent {
+    uint32_t tick;
+    uint8_t cmd;
+};
+
+struct Recording {
+    uint32_t seed = 0;
+    uint8_t difficulty = 2;
+    uint8_t loaders = 1;
+    uint16_t width = 80, height = 24;
+    uint16_t rocketStepMs = ROCKET_STEP_MS;
+    uint16_t enemyStepMs = 0;
+    std::vector<InputEvent> events;
+};
+
+bool saveRecording(const char* path, const Recording& r) {
+    std::vector<uint8_t> out = { 'A', 'A', 'R', '2' };
+    auto put = [&](uint32_t v, int bytes) { for (int i = 0; i < bytes; ++i) out.push_back((v >> (8*i)) & 0xff); };
+    put(r.seed, 4);
+    put(r.difficulty, 1);
+    put(r.loaders, 1);
+    put(r.width, 2);
+    put(r.height, 2);
+    put(r.rocketStepMs, 2);
+    put(r.enemyStepMs, 2);
+    uint32_t last = 0;
+    for (const auto& ev : r.events) {
+        uint32_t delta = ev.tick - last;
+        last = ev.tick;
+        do {
+            uint8_t b = delta & 0x7f;
+            delta >>= 7;
+            out.push_back(delta ? (b | 0x80) : b);
+        } while (delta);
+        out.push_back(ev.cmd);
+    }
+
+    FILE* f = fopen(path, "wb");
+    if (!f) return false;
+    bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+    return fclose(f) == 0 && ok;
+}
+
+bool loadRecording(const char* path, Recording& r) {
+    FILE* f = fopen(path, "rb");
+    if (!f) return false;
+    std::vector<uint8_t> in;
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) in.insert(in.end(), buf, buf + n);
+    fclose(f);
+
+    size_t header = 0;
+    if (in.size() >= 14 && memcmp(in.data(), "AAR1", 4) == 0) header = 14;
+    else if (in.size() >= 18 && memcmp(in.data(), "AAR2", 4) == 0) header = 18;
+    else return false;
+    auto get = [&](size_t at, int bytes) { uint32_t v = 0; for (int i = 0; i < bytes; ++i) v |= (uint32_t)in[at+i] << (8*i); return v; };
+    r.seed = get(4, 4);
+    r.difficulty = (uint8_t)get(8, 1);
+    r.loaders = std::max<uint8_t>(1, (uint8_t)get(9, 1));
+    r.width = (uint16_t)get(10, 2);
+    r.height = (uint16_t)get(12, 2);
+    r.rocketStepMs = header == 18 ? (uint16_t)get(14, 2) : ROCKET_STEP_MS;
+    r.enemyStepMs = header == 18 ? (uint16_t)get(16, 2) : 0;
+    if (r.difficulty < 1 || r.difficulty > 3 || r.rocketStepMs == 0) return false;
+    if (r.width < MIN_SCREEN_W || r.height < MIN_SCREEN_H) return false;
+    if (r.width > MAX_SCREEN_W || r.height > MAX_SCREEN_H) return false;
+
+    r.events.clear();
+    uint32_t tick = 0;
+    size_t at = header;
+    while (at < in.size()) {
+        uint32_t delta = 0;
+        int shift = 0;
+        while (at < in.size() && (in[at] & 0x80)) {
+            delta |= (uint32_t)(in[at++] & 0x7f) << shift;
+            shift += 7;
+            if (shift > 28) return false;          // longer than a u32 delta
+        }
+        if (at + 1 >= in.size()) return false;     // need the last delta byte and the command
+        delta |= (uint32_t)in[at++] << shift;
+        tick += delta;
+        r.events.push_back(InputEvent{tick, in[at++]});
+    }
+    return true;
+}
 
 // ---------- Globals de jogo ----------
 int SCREEN_H = 24, SCREEN_W = 80;
 
-std::vector<Enemy> enemies;
-std::vector<Rocket> rockets;
+EnemyTable enemies;
+RocketTable rockets;
+EnemyGrid enemyGrid;
+
+// runs the enemy / rocket threads of --entity-threads (--entity-stack-kb N)
+EntityWorkers entityWorkers;
+int entityStackKb = 64;
+int entityWorkerCount = 0;     // --entity-workers N; 0 = one per entity that can be alive at once, up to MAX_ENTITY_WORKERS
+
+// thread arguments for --entity-threads, sized by reserveEntityStorage()
+EntityPool<Enemy> enemyArgs;
+EntityPool<Rocket> rocketArgs;
 
-pthread_mutex_t enemyListMutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t rocketListMutex = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t batteryMutex    = PTHREAD_MUTEX_INITIALIZER;
-pthread_mutex_t screenMutex     = PTHREAD_MUTEX_INITIALIZER;
-pthread_cond_t  batteryNotFull  = PTHREAD_COND_INITIALIZER;
+GameMutex enemyListMutex("enemyList");
+GameMutex rocketListMutex("rocketList");
+GameMutex batteryMutex("battery");
+GameMutex screenMutex("screen");
+pthread_cond_t  reloadWork      = PTHREAD_COND_INITIALIZER;   // a job was queued or the game stopped
 
 // battery state
-std::vector<bool> launchers; // true = contém foguete
-int k_launchers_global = 0;
+LauncherBattery battery;     // lock-free
+ReloadQueue reloadJobs;      // guarded by batteryMutex
+
+// loaders (--loaders N); each loader writes only its own stats, read after the join
+struct LoaderStats {
+    int64_t busyMs = 0;        // time spent loading
+    int jobs = 0;
+    int64_t queuedTotalMs = 0; // launcher emptied -> a loader starts on it
+    int64_t queuedMaxMs = 0;
+    int64_t latencyTotalMs = 0; // launcher emptied -> loaded again
+    int64_t latencyMaxMs = 0;
+};
+int loaderCount = 1;
+std::vector<LoaderStats> loaderStats;
+
+// simulation workers (--workers N): the simulation thread plus N-1 helpers
+int workerCount = 1;
+TaskPool tickPool;
+
+// latency histograms (the four mutexes carry their own wait histograms)
+LatencyHistogram tickTimes;        // simulation work per tick, sleep excluded
+LatencyHistogram frameTimes;       // one drawScreen
+LatencyHistogram inputToFire;      // fire key / bot decision -> rocket launched
+LatencyHistogram fireToMove;       // --entity-threads: rocket launched -> its thread's first step
+LatencyHistogram reloadTimes;      // launcher emptied -> loaded again (game clock)
+std::atomic<bool> statsOverlay{false};   // toggled with 'p'
 
 // counters
 std::atomic<int> destroyedEnemies{0};
@@ -66,89 +1706,263 @@ std::atomic<int> spawnedEnemies{0};
 // threads control
 std::atomic<bool> gameRunning{true};
 std::atomic<bool> spawnDone{false};
+std::atomic<int64_t> stopRequestedNs{0};   // first stopGame(), for the shutdown latency
 
 // settings in use
 DifficultySettings settings;
-
-// ncurses window
+const char* difficultyName = "MEDIUM";
+EngineMode engineMode = ENGINE_TICK;
+int rocketStepMs = ROCKET_STEP_MS;     // ms per rocket step (--rocket-step-ms)
+int enemyStepMs = 0;                   // --enemy-step-ms; 0 keeps the difficulty's
+int enemyCount = 0;                    // --enemies (headless stress waves); 0 keeps the difficulty's
+int spawnIntervalMs = -1;              // --spawn-interval-ms; < 0 keeps the difficulty's
+
+// timing and run mode
+RealClock realClock;
+VirtualClock virtualClock;
+GameClock* gameClock = &realClock;
+bool headless = false;         // no ncurses: bot input, report on stdout
+bool dumpStats = false;        // --stats: latency table on stdout at exit
+const char* tracePath = nullptr;   // --trace FILE
+const char* recordPath = nullptr;
+bool replaying = false;
+Recording recording;           // commands being recorded, or the game being replayed
+int gameResult = 0;            // 1 win, -1 lose, 0 quit
+
+// ncurses window and its shadow frame (both guarded by screenMutex)
 WINDOW* gamewin = nullptr;
+FrameBuffer frame;
 
-// aim state (protected by batteryMutex or separate mutex)
-Aim currentAim = AIM_UP;
+// overlay texts; own lock so the simulation can post one without waiting on terminal I/O
+std::vector<ScreenMessage> messages;
+pthread_mutex_t messageMutex = PTHREAD_MUTEX_INITIALIZER;
 
-// random
+// rendering: the simulation publishes snapshots, the render thread draws them
+TripleBuffer<WorldSnapshot> snapshots;
+int targetFps = 30;
+std::atomic<bool> renderRunning{true};
+StopSignal renderStop;         // raised with renderRunning = false: cuts the frame wait
+
+// input: the player controller blocks in poll() on stdin and on this pipe;
+// a byte written to inputWake[1] tells it the game is over
+int inputWake[2] = { -1, -1 };
+
+// wall clock: raised when a player command is queued, and at game over; cuts
+// the simulation's wait for the next tick short (waitForTick)
+StopSignal commandQueued;
+
+// aim state; written by whoever applies commands, read by fire and snapshots
+std::atomic<Aim> currentAim{AIM_UP};
+
+// random; seeded from --seed (or the time) and only used by the spawner
 std::mt19937 rng;
+uint32_t gameSeed = 0;
 
 // ids
 std::atomic<int> nextEnemyId{1};
 std::atomic<int> nextRocketId{1};
 
 // ---------- Helper functions ----------
-void drawScreen() {
-    pthread_mutex_lock(&screenMutex);
-    werase(gamewin);
+
+// queue text to draw over the frame for ms milliseconds (ms <= 0: until the end)
+void showMessage(int x, int y, int ms, const char* fmt, ...) {
+    char buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+
+    ScreenMessage msg;
+    msg.x = x; msg.y = y;
+    msg.text = buf;
+    msg.sticky = ms <= 0;
+    msg.until = std::chrono::steady_clock::now() + std::chrono::milliseconds(ms);
+
+    pthread_mutex_lock(&messageMutex);
+    messages.push_back(msg);
+    pthread_mutex_unlock(&messageMutex);
+}
+
+// copy the world into s; caller holds enemyListMutex and rocketListMutex
+void captureSnapshot(WorldSnapshot& s) {
+    s.destroyed = destroyedEnemies.load();
+    s.ground = groundHits.load();
+    s.spawned = spawnedEnemies.load();
+    s.enemyLive = enemies.size();
+    s.enemySlots = enemies.slotCount();
+    s.rocketLive = rockets.size();
+    s.rocketSlots = rockets.slotCount();
+
+    s.enemies.clear();
+    for (size_t i = 0; i < enemies.size(); ++i) s.enemies.push_back(Cell{enemies.x[i], enemies.y[i]});
+    s.rockets.clear();
+    for (size_t i = 0; i < rockets.size(); ++i) s.rockets.push_back(Cell{rockets.x[i], rockets.y[i]});
+
+    s.battery.resize(battery.size());
+    for (int i = 0; i < battery.size(); ++i) s.battery[i] = battery.loaded(i);
+    s.aim = currentAim;
+}
+
+// hand the current world to the render thread; caller holds both list mutexes
+void publishSnapshot() {
+    captureSnapshot(snapshots.writeBuffer());
+    snapshots.publish();
+}
+
+// draw a snapshot into fb (no locks, no terminal I/O)
+void composeFrame(const WorldSnapshot& s, FrameBuffer& fb) {
+    fb.clear();
 
     // header
-    mvwprintw(gamewin, 0, 1, "Antiaereo - Fogo em massa!  Press Q para sair");
-    mvwprintw(gamewin, 1, 1, "Destroyed: %d    Ground hits: %d    Spawned: %d/%d",
-              destroyedEnemies.load(), groundHits.load(), spawnedEnemies.load(), settings.m_enemies);
+    fb.print(1, 0, "Antiaereo - Fogo em massa!  Press Q para sair");
+    fb.print(1, 1, "Destroyed: %d    Ground hits: %d    Spawned: %d/%d",
+             s.destroyed, s.ground, s.spawned, settings.m_enemies);
+
+    // live entities vs allocated slots (should stay flat on long waves)
+    fb.print(1, 2, "Live/slots E:%zu/%zu R:%zu/%zu",
+             s.enemyLive, s.enemySlots, s.rocketLive, s.rocketSlots);
 
     // battery display top-right
     int bx = SCREEN_W - 28;
-    mvwprintw(gamewin, 2, bx, "Battery (k=%d):", k_launchers_global);
-    pthread_mutex_lock(&batteryMutex);
-    for (int i = 0; i < k_launchers_global; ++i) {
-        mvwprintw(gamewin, 3 + i/8, bx + (i%8)*3, "%c", launchers[i] ? 'O' : '.');
+    fb.print(bx, 2, "Battery (k=%d):", (int)s.battery.size());
+    for (int i = 0; i < (int)s.battery.size(); ++i) {
+        fb.put(bx + (i%8)*3, 3 + i/8, s.battery[i] ? 'O' : '.');
     }
-    pthread_mutex_unlock(&batteryMutex);
 
     // show aim
     const char* aimText = "";
-    switch (currentAim) {
+    switch (s.aim) {
         case AIM_UP: aimText = "90° (|)"; break;
         case AIM_UPLEFT: aimText = "45° (\\)"; break;
         case AIM_UPRIGHT: aimText = "45° (/)"; break;
         case AIM_LEFT: aimText = "180° left (--)"; break;
         case AIM_RIGHT: aimText = "180° right (--)"; break;
     }
-    mvwprintw(gamewin, 6, bx, "Aim: %s", aimText);
+    fb.print(bx, 6, "Aim: %s", aimText);
 
-    // draw border and ground
+    // ground
     for (int x = 0; x < SCREEN_W-1; ++x) {
-        mvwprintw(gamewin, SCREEN_H-2, x, "="); // ground line
+        fb.put(x, SCREEN_H-2, '='); // ground line
     }
 
     // enemies
-    pthread_mutex_lock(&enemyListMutex);
-    for (const auto& e : enemies) {
-        if (!e.alive) continue;
+    for (const auto& e : s.enemies) {
         if (e.y >= 0 && e.y < SCREEN_H-2 && e.x >= 0 && e.x < SCREEN_W-1) {
-            mvwprintw(gamewin, e.y, e.x, "V"); // enemy glyph
+            fb.put(e.x, e.y, 'V'); // enemy glyph
         }
     }
-    pthread_mutex_unlock(&enemyListMutex);
 
     // rockets
-    pthread_mutex_lock(&rocketListMutex);
-    for (const auto& r : rockets) {
-        if (!r.active) continue;
+    for (const auto& r : s.rockets) {
         if (r.y >= 0 && r.y < SCREEN_H-2 && r.x >= 0 && r.x < SCREEN_W-1) {
-            mvwprintw(gamewin, r.y, r.x, "*");
+            fb.put(r.x, r.y, '*');
         }
     }
-    pthread_mutex_unlock(&rocketListMutex);
 
     // footer
-    mvwprintw(gamewin, SCREEN_H-1, 1, "Objective: shoot at least 50%% of enemies to win.");
+    fb.print(1, SCREEN_H-1, "Objective: shoot at least 50%% of enemies to win.");
+
+    fb.drawBox();
+}
+
+// every latency histogram, in display order: f(label, histogram)
+template <typename F>
+void forEachHistogram(F f) {
+    f("tick", tickTimes);
+    f("frame", frameTimes);
+    f("input->fire", inputToFire);
+    f("fire->move", fireToMove);
+    f("reload", reloadTimes);
+    for (GameMutex* m : { &enemyListMutex, &rocketListMutex, &batteryMutex, &screenMutex }) {
+        char label[32];
+        snprintf(label, sizeof(label), "%s wait", m->name);
+        f(label, m->waits);
+    }
+}
+
+// latency table under the battery and aim panel (rows 2-6, more for a battery
+// over 32 launchers), cut at the ground line so it never covers either
+void drawStatsOverlay(FrameBuffer& fb) {
+    int x = 2, y = std::max(7, 3 + (settings.k_launchers + 7) / 8);
+    if (y >= SCREEN_H-2) return;
+    fb.print(x, y++, "%-16s %7s %8s %8s %8s", "latency (p)", "n", "p50", "p99", "max");
+    forEachHistogram([&](const char* name, const LatencyHistogram& h) {
+        if (y >= SCREEN_H-2) return;
+        char a[16], b[16], c[16];
+        fb.print(x, y++, "%-16s %7llu %8s %8s %8s", name, (unsigned long long)h.count(),
+                 formatNs(h.percentile(0.5), a, sizeof(a)), formatNs(h.percentile(0.99), b, sizeof(b)),
+                 formatNs(h.max(), c, sizeof(c)));
+    });
+}
 
-    box(gamewin, 0, 0);
-    wrefresh(gamewin);
-    pthread_mutex_unlock(&screenMutex);
+void printStats(FILE* out) {
+    fprintf(out, "%-16s %9s %9s %9s %9s %9s %9s\n", "latency", "n", "mean", "p50", "p90", "p99", "max");
+    forEachHistogram([&](const char* name, const LatencyHistogram& h) {
+        char a[16], b[16], c[16], d[16], e[16];
+        fprintf(out, "%-16s %9llu %9s %9s %9s %9s %9s\n", name, (unsigned long long)h.count(),
+                formatNs(h.mean(), a, sizeof(a)), formatNs(h.percentile(0.5), b, sizeof(b)),
+                formatNs(h.percentile(0.9), c, sizeof(c)), formatNs(h.percentile(0.99), d, sizeof(d)),
+                formatNs(h.max(), e, sizeof(e)));
+    });
+}
+
+// per call site lock stats of the four game mutexes, most waited-on first
+void printLockProfile(FILE* out) {
+    fprintf(out, "%-11s %-34s %8s %9s %9s %9s %9s\n",
+            "lock", "call site", "n", "wait", "wait max", "hold", "hold max");
+    for (GameMutex* m : { &enemyListMutex, &rocketListMutex, &batteryMutex, &screenMutex }) {
+        std::vector<const GameMutex::Site*> used;
+        const GameMutex::Site* table = m->siteTable();
+        for (int i = 0; i < GameMutex::MAX_SITES; ++i)
+            if (table[i].func.load() || table[i].count.load()) used.push_back(&table[i]);
+        std::sort(used.begin(), used.end(), [](const GameMutex::Site* a, const GameMutex::Site* b) {
+            return a->waitNs.load() > b->waitNs.load();
+        });
+        for (const GameMutex::Site* st : used) {
+            char site[64], a[16], b[16], c[16], d[16];
+            if (st->func.load()) snprintf(site, sizeof(site), "%s:%d", st->func.load(), st->line.load());
+            else snprintf(site, sizeof(site), "(other sites)");
+            fprintf(out, "%-11s %-34s %8llu %9s %9s %9s %9s\n", m->name, site,
+                    (unsigned long long)st->count.load(),
+                    formatNs(st->waitNs.load(), a, sizeof(a)), formatNs(st->maxWaitNs.load(), b, sizeof(b)),
+                    formatNs(st->holdNs.load(), c, sizeof(c)), formatNs(st->maxHoldNs.load(), d, sizeof(d)));
+        }
+    }
+}
+
+// render the latest snapshot; called by the render thread only (and by main once it is gone)
+void drawScreen() {
+    // entity threads have no tick to publish from, so the renderer captures itself
+    if (engineMode == ENGINE_THREADS) {
+        enemyListMutex.lock();
+        rocketListMutex.lock();
+        publishSnapshot();
+        rocketListMutex.unlock();
+        enemyListMutex.unlock();
+    }
+    snapshots.update();
+
+    screenMutex.lock();
+    composeFrame(snapshots.readBuffer(), frame);
+
+    // messages go on top of everything; expired ones are dropped
+    auto now = std::chrono::steady_clock::now();
+    pthread_mutex_lock(&messageMutex);
+    messages.erase(std::remove_if(messages.begin(), messages.end(),
+                                  [&](const ScreenMessage& m){ return !m.sticky && m.until <= now; }),
+                   messages.end());
+    for (const auto& m : messages) frame.print(m.x, m.y, "%s", m.text.c_str());
+    pthread_mutex_unlock(&messageMutex);
+    if (statsOverlay) drawStatsOverlay(frame);
+
+    frame.flush(gamewin);
+    screenMutex.unlock();
 }
 
 // convert aim to step dx, dy per rocket tick
 void aimToStep(Aim a, int &dx, int &dy) {
     // dy negative = up (since enemies come from top to bottom)
+    dx = 0; dy = -1;
     switch (a) {
         case AIM_UP:     dx = 0; dy = -1; break;
         case AIM_UPLEFT: dx = -1; dy = -1; break;
@@ -158,11 +1972,114 @@ void aimToStep(Aim a, int &dx, int &dy) {
     }
 }
 
-// safe remove rocket by id
-void removeRocketById(int id) {
-    pthread_mutex_lock(&rocketListMutex);
-    rockets.erase(std::remove_if(rockets.begin(), rockets.end(), [&](const Rocket& r){ return r.id == id; }), rockets.end());
-    pthread_mutex_unlock(&rocketListMutex);
+bool rocketOffscreen(int x, int y) {
+    return x < 1 || x >= SCREEN_W-1 || y < 1 || y >= SCREEN_H-2;
+}
+
+// most rockets that can be in flight at once: the full battery plus, for
+// every loader, one per reload it completes during the longest possible flight.
+// Capped at one per cell of the field (or the battery, if larger): slow
+// rockets and many loaders would otherwise reserve millions of records, and
+// with --entity-threads a shot past the cap is refused like any exhausted pool.
+int maxRocketsInFlight() {
+    int64_t flightMs = (int64_t)std::max(SCREEN_W, SCREEN_H) * rocketStepMs;
+    int64_t n = settings.k_launchers + loaderCount * (flightMs / std::max(1, settings.reload_time_ms) + 1);
+    return (int)std::min(n, (int64_t)std::max(settings.k_launchers, SCREEN_W * SCREEN_H));
+}
+
+// size entity storage from the difficulty, so spawning and firing during the
+// game reuse preallocated records instead of growing the heap
+void reserveEntityStorage() {
+    int m = settings.m_enemies;
+    int r = maxRocketsInFlight();
+    enemies.reserve(m);
+    rockets.reserve(r);
+    enemyGrid.reserve(m);
+    // only entity threads take their arguments from the pools
+    if (engineMode == ENGINE_THREADS) {
+        enemyArgs.init(m);
+        rocketArgs.init(r);
+    }
+}
+
+// kill and reclaim the enemy in slot; caller holds enemyListMutex
+void killEnemy(int slot) {
+    int i = (int)enemies.index.denseOf(slot);
+    traceInstant("hit", "enemy", enemies.id[i]);
+    enemyGrid.remove(slot, enemies.x[i], enemies.y[i]);
+    enemies.erase(enemies.index.handleOf(slot));
+    destroyedEnemies++;
+}
+
+// kill and reclaim the enemy standing on (x, y), if any; caller holds enemyListMutex
+bool hitEnemyAt(int x, int y) {
+    int slot = enemyGrid.at(x, y);
+    if (slot == -1) return false;
+    killEnemy(slot);
+    return true;
+}
+
+// Two cells moving in straight lines over the same interval, a + t*b apart
+// at time t in [0, 1] (a: offset at the start, b: relative motion), touch
+// while they are less than half a cell apart on both axes. Sets t to the
+// first contact; false if they never touch.
+bool sweptContact(int ax, int ay, int bx, int by, double &t) {
+    double lo = 0, hi = 1;
+    auto axis = [&](int a, int b) {
+        if (b == 0) {
+            if (a != 0) hi = -1;
+            return;
+        }
+        double t0 = (-0.5 - a) / b, t1 = (0.5 - a) / b;
+        if (t0 > t1) std::swap(t0, t1);
+        lo = std::max(lo, t0);
+        hi = std::min(hi, t1);
+    };
+    axis(ax, bx);
+    axis(ay, by);
+    if (lo >= hi) return false;
+    t = lo;
+    return true;
+}
+
+// slot of the enemy whose path this tick (prevY -> y) meets the rocket's path
+// from (x0, y0) to (x1, y1), the earliest contact first and the lowest id on
+// a tie, or -1. Enemies only move down, at most reach rows per tick, so the
+// candidates are the cells under the rocket's path extended reach rows down.
+// Caller holds enemyListMutex.
+int sweptEnemyHit(int x0, int y0, int x1, int y1, int reach) {
+    int xa = std::max(0, std::min(x0, x1)), xb = std::min(enemyGrid.w - 1, std::max(x0, x1));
+    int ya = std::max(0, std::min(y0, y1)), yb = std::min(enemyGrid.h - 1, std::max(y0, y1) + reach);
+    int best = -1, bestId = 0;
+    double bestT = 0;
+    for (int cy = ya; cy <= yb; ++cy) {
+        for (int cx = xa; cx <= xb; ++cx) {
+            for (int slot = enemyGrid.at(cx, cy); slot != -1; slot = enemyGrid.next[slot]) {
+                int i = (int)enemies.index.denseOf(slot);
+                int ey0 = enemies.prevY[i];
+                double t;
+                if (!sweptContact(x0 - cx, y0 - ey0, x1 - x0, (y1 - y0) - (cy - ey0), t)) continue;
+                if (best == -1 || t < bestT || (t == bestT && enemies.id[i] < bestId)) {
+                    best = slot; bestT = t; bestId = enemies.id[i];
+                }
+            }
+        }
+    }
+    return best;
+}
+
+// dense index of the rocket on (x, y), or -1; caller holds rocketListMutex
+int rocketAt(int x, int y) {
+    for (size_t i = 0; i < rockets.size(); ++i)
+        if (rockets.x[i] == x && rockets.y[i] == y) return (int)i;
+    return -1;
+}
+
+// safe remove rocket by handle
+void removeRocket(Handle h) {
+    rocketListMutex.lock();
+    rockets.erase(h);
+    rocketListMutex.unlock();
 }
 
 // ---------- Thread functions ----------
@@ -170,38 +2087,37 @@ void removeRocketById(int id) {
 // rocketThread: move rocket until offscreen or hit
 void* rocketThreadFn(void* arg) {
     Rocket r = *(Rocket*)arg;
-    delete (Rocket*)arg;
+    rocketArgs.release((Rocket*)arg);
+    traceEntity("rocket", r.id);
 
     int dx, dy;
     aimToStep(r.aim, dx, dy);
 
-    while (gameRunning && r.active) {
+    while (gameRunning) {
         // move
         r.x += dx;
         r.y += dy;
 
-        // update global rocket position
-        pthread_mutex_lock(&rocketListMutex);
-        for (auto &gr : rockets) {
-            if (gr.id == r.id) {
-                gr.x = r.x; gr.y = r.y;
-                break;
-            }
+        traceInstant("move", "y", r.y);
+
+        // update global rocket position and check for an enemy on the new
+        // cell; a stale handle means an enemy ran into us since the last step.
+        // lock order: enemies before rockets
+        enemyListMutex.lock();
+        rocketListMutex.lock();
+        int i = rockets.find(r.self);
+        bool hit = i < 0;
+        if (!hit) {
+            rockets.x[i] = r.x;
+            rockets.y[i] = r.y;
+            hit = hitEnemyAt(r.x, r.y);
         }
-        pthread_mutex_unlock(&rocketListMutex);
-
-        // collision check with enemies
-        bool hit = false;
-        pthread_mutex_lock(&enemyListMutex);
-        for (auto &e : enemies) {
-            if (e.alive && e.x == r.x && e.y == r.y) {
-                e.alive = false;
-                hit = true;
-                destroyedEnemies++;
-                break;
-            }
+        rocketListMutex.unlock();
+        enemyListMutex.unlock();
+        if (r.firedNs) {
+            fireToMove.record(steadyNowNs() - r.firedNs);
+            r.firedNs = 0;
         }
-        pthread_mutex_unlock(&enemyListMutex);
 
         if (hit) {
             // rocket ends
@@ -209,63 +2125,457 @@ void* rocketThreadFn(void* arg) {
         }
 
         // offscreen?
-        if (r.x < 1 || r.x >= SCREEN_W-1 || r.y < 1 || r.y >= SCREEN_H-2) {
+        if (rocketOffscreen(r.x, r.y)) {
             break;
         }
 
-        std::this_thread::sleep_for(70ms);
-    }
-
-    // mark rocket inactive and remove from list
-    pthread_mutex_lock(&rocketListMutex);
-    for (auto &gr : rockets) {
-        if (gr.id == r.id) {
-            gr.active = false;
-            break;
-        }
+        int64_t t0 = traceBegin();
+        gameClock->sleepFor(rocketStepMs);
+        traceEnd("sleep", t0, "ms", rocketStepMs);
     }
-    pthread_mutex_unlock(&rocketListMutex);
 
-    // notify reload thread there's space (a launcher is logically empty already at firing time)
-    pthread_cond_signal(&batteryNotFull);
+    // remove from list (its launcher was queued for reload when it was fired)
+    removeRocket(r.self);
     return nullptr;
 }
 
 // enemyThread: each enemy descends until ground or destroyed
 void* enemyThreadFn(void* arg) {
     Enemy e = *(Enemy*)arg;
-    delete (Enemy*)arg;
+    enemyArgs.release((Enemy*)arg);
+    traceEntity("enemy", e.id);
 
     while (gameRunning && e.alive) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(settings.enemy_step_ms));
+        int64_t t0 = traceBegin();
+        gameClock->sleepFor(settings.enemy_step_ms);
+        traceEnd("sleep", t0, "ms", settings.enemy_step_ms);
+        if (!gameRunning) break;       // the sleep was cut short by the game ending
 
-        // move down
+        // move down; a stale handle means a rocket already destroyed us
         e.y += 1;
 
-        pthread_mutex_lock(&enemyListMutex);
-        for (auto &ge : enemies) {
-            if (ge.id == e.id) {
-                ge.y = e.y;
-                break;
+        enemyListMutex.lock();
+        int i = enemies.find(e.self);
+        if (i < 0) {
+            e.alive = false;
+        } else if (e.y >= SCREEN_H-2) {
+            // reached ground
+            traceInstant("ground", "enemy", e.id);
+            enemyGrid.remove((int)e.self.index, enemies.x[i], enemies.y[i]);
+            enemies.erase(e.self);
+            groundHits++;
+            e.alive = false;
+        } else {
+            traceInstant("move", "y", e.y);
+            enemyGrid.move((int)e.self.index, enemies.x[i], enemies.y[i], enemies.x[i], e.y);
+            enemies.prevY[i] = enemies.y[i];
+            enemies.y[i] = e.y;
+
+            // moving onto a rocket is a hit too, or the two could swap cells
+            // between their steps; its thread sees the stale handle and ends
+            rocketListMutex.lock();
+            int r = rocketAt(e.x, e.y);
+            if (r >= 0) rockets.eraseAt(r);
+            rocketListMutex.unlock();
+            if (r >= 0) {
+                killEnemy((int)e.self.index);
+                e.alive = false;
             }
         }
-        pthread_mutex_unlock(&enemyListMutex);
+        enemyListMutex.unlock();
+    }
 
-        // reached ground?
-        if (e.y >= SCREEN_H-2) {
-            pthread_mutex_lock(&enemyListMutex);
-            for (auto &ge : enemies) {
-                if (ge.id == e.id && ge.alive) {
-                    ge.alive = false;
-                    groundHits++;
-                    break;
-                }
+    return nullptr;
+}
+
+// ---------- Player actions (keyboard or bot) ----------
+void setAim(Aim a) {
+    currentAim = a;
+}
+
+bool batteryHasRocket() {
+    return battery.any();
+}
+
+// hand an emptied launcher to the loaders
+void queueReload(int launcher) {
+    batteryMutex.lock();
+    reloadJobs.push(ReloadJob{launcher, gameClock->nowMs()});
+    gameClock->notify(&reloadWork, false);
+    batteryMutex.unlock();
+}
+
+// consume the first loaded launcher and launch a rocket with the current aim;
+// false if every launcher is empty
+bool fireRocket() {
+    // attempt fire: consume first launcher that contains a rocket
+    int chosen = battery.fire();
+    if (chosen == -1) return false;
+    Aim aim = currentAim;
+
+    Rocket* rarg = nullptr;
+    if (engineMode == ENGINE_THREADS && !(rarg = rocketArgs.acquire())) {
+        // every record is in flight: the shot does not leave, the rocket stays loaded
+        battery.load(chosen);
+        return false;
+    }
+
+    // create rocket at bottom center-ish
+    Rocket rr;
+    rr.id = nextRocketId++;
+    rr.aim = aim;
+    rr.stepAcc = rocketStepMs;   // first step on the next tick, like the rocket thread
+    rr.firedNs = 0;
+
+    // starting position: center-bottom above ground
+    rr.x = SCREEN_W / 2;
+    rr.y = SCREEN_H - 3;
+
+    // push and start thread (the tick engine picks it up from the list)
+    rocketListMutex.lock();
+    rr.self = rockets.insert(rr);
+    rocketListMutex.unlock();
+
+    if (rarg) {
+        *rarg = rr;
+        rarg->firedNs = steadyNowNs();
+        if (!entityWorkers.submit(rocketThreadFn, rarg)) {
+            // no thread for the rocket: the shot does not leave, as with an exhausted pool
+            removeRocket(rr.self);
+            rocketArgs.release(rarg);
+            battery.load(chosen);
+            return false;
+        }
+    }
+    queueReload(chosen);
+    traceInstant("fire", "launcher", chosen);
+    return true;
+}
+
+void wakeInput() {
+    if (inputWake[1] != -1) {
+        char b = 1;
+        ssize_t n = write(inputWake[1], &b, 1);
+        (void)n;
+    }
+}
+
+// end the game and wake every thread that sleeps on an event. gameRunning is
+// cleared under batteryMutex, so a loader is either still before its check
+// (and will see it) or already waiting (and gets the broadcast).
+void stopGame() {
+    int64_t none = 0;
+    stopRequestedNs.compare_exchange_strong(none, steadyNowNs());
+    batteryMutex.lock();
+    gameRunning = false;
+    gameClock->notify(&reloadWork, true);
+    batteryMutex.unlock();
+    gameClock->cancelSleeps();
+    commandQueued.raise();
+    wakeInput();
+}
+
+// ---------- Player commands ----------
+// Keyboard and bot do not touch the game directly in tick mode: they queue
+// commands and the simulation applies them at the start of a tick, which is
+// what makes a recorded game replay tick for tick. On the wall clock it does
+// not wait for that tick: a queued command wakes it between ticks and is
+// applied at once (waitForTick). The queue is an SPSC ring
+// (one player thread in, the simulation out), so submitting never waits on
+// a simulation lock.
+enum CommandType : uint8_t {
+    CMD_AIM_UP, CMD_AIM_UPLEFT, CMD_AIM_UPRIGHT, CMD_AIM_LEFT, CMD_AIM_RIGHT,   // same order as Aim
+    CMD_FIRE,
+    CMD_QUIT
+};
+
+struct QueuedCommand {
+    uint8_t cmd;
+    int64_t submittedNs;       // steady clock, for the queue latency metric
+};
+
+const size_t COMMAND_QUEUE_SIZE = 256;
+SpscRing<QueuedCommand, COMMAND_QUEUE_SIZE> pendingCommands;
+
+// queue metrics: written by the player thread (submitted, dropped, maxDepth)
+// or the simulation (applied, latency); read at exit
+struct CommandQueueStats {
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> dropped{0};          // queue full
+    std::atomic<size_t> maxDepth{0};
+    uint64_t applied = 0;
+    int64_t latencyTotalNs = 0;
+    int64_t latencyMaxNs = 0;
+} commandStats;
+
+uint32_t commandsPausedUntil = 0;        // tick; the "No rockets" pause (simulation thread only)
+std::atomic<bool> quitRequested{false};  // set with every CMD_QUIT: a full queue or the pause cannot hold it
+size_t replayPos = 0;
+
+// false if a fire found every launcher empty
+bool applyCommand(uint8_t cmd) {
+    if (cmd <= CMD_AIM_RIGHT) {
+        setAim((Aim)cmd);
+    } else if (cmd == CMD_FIRE) {
+        if (!fireRocket()) {
+            // optional: beep or message (no rockets available)
+            showMessage(2, SCREEN_H-3, NO_ROCKETS_PAUSE_MS, "No rockets available!");
+            return false;
+        }
+    } else if (cmd == CMD_QUIT) {
+        stopGame();
+    }
+    return true;
+}
+
+void submitCommand(uint8_t cmd) {
+    if (engineMode == ENGINE_THREADS) {
+        // no tick to wait for: apply now, pausing the caller like before
+        int64_t t0 = steadyNowNs();
+        if (!applyCommand(cmd)) gameClock->sleepFor(NO_ROCKETS_PAUSE_MS);
+        else if (cmd == CMD_FIRE) inputToFire.record(steadyNowNs() - t0);
+        return;
+    }
+    commandStats.submitted++;
+    if (cmd == CMD_QUIT) quitRequested = true;
+    if (!pendingCommands.push(QueuedCommand{cmd, steadyNowNs()})) {
+        commandStats.dropped++;
+        return;
+    }
+    size_t depth = pendingCommands.size();
+    if (depth > commandStats.maxDepth) commandStats.maxDepth = depth;
+    if (gameClock == &realClock && !replaying) commandQueued.raise();
+}
+
+// apply this tick's commands (recorded ones when replaying); simulation thread only,
+// before it takes the list locks
+void drainCommands(uint32_t tick) {
+    if (replaying) {
+        while (replayPos < recording.events.size() && recording.events[replayPos].tick <= tick) {
+            applyCommand(recording.events[replayPos++].cmd);
+        }
+        return;
+    }
+    while (tick >= commandsPausedUntil) {
+        const QueuedCommand* q = pendingCommands.front();
+        if (!q) break;
+        uint8_t cmd = q->cmd;
+        int64_t waited = steadyNowNs() - q->submittedNs;
+        pendingCommands.pop();
+
+        commandStats.applied++;
+        commandStats.latencyTotalNs += waited;
+        commandStats.latencyMaxNs = std::max(commandStats.latencyMaxNs, waited);
+        if (recordPath) recording.events.push_back(InputEvent{tick, cmd});
+        if (!applyCommand(cmd)) commandsPausedUntil = tick + NO_ROCKETS_PAUSE_MS / TICK_MS;
+        else if (cmd == CMD_FIRE) inputToFire.record(waited);
+    }
+    if (quitRequested && gameRunning) {
+        // the quit is still queued behind the pause, or the queue was full
+        if (recordPath) recording.events.push_back(InputEvent{tick, CMD_QUIT});
+        applyCommand(CMD_QUIT);
+    }
+}
+
+// sleep until the tick due at next (game ms) starts. On the wall clock every
+// command queued meanwhile is applied as it arrives instead of at that tick;
+// --record and --replay run on the virtual clock, which applies commands only
+// at tick start.
+void waitForTick(int64_t next, uint32_t tick) {
+    if (gameClock != &realClock || replaying) {
+        gameClock->sleepUntil(next);
+        return;
+    }
+    while (!commandQueued.sleepUntil(realClock.at(next)) && gameRunning) {
+        commandQueued.reset();
+        drainCommands(tick);
+    }
+}
+
+// ---------- Tick engine ----------
+// Each entity accumulates TICK_MS per tick and takes one step for every full
+// step interval accumulated, so speeds are preserved without a thread per entity.
+
+// Both passes split the tables into chunks of TICK_CHUNK entities stepped on
+// tickPool, each chunk writing only its own entities' columns and scratch
+// slots. Everything shared (grid, counters, erasures, kills) is then applied
+// on the simulation thread in the order a single pass visits the entities,
+// so the outcome does not depend on the worker count or on who stole what.
+const int TICK_CHUNK = 1024;
+
+struct TickScratch {
+    std::vector<uint8_t> landed;            // per enemy: reached the ground
+    std::vector<std::vector<int>> moved;    // per chunk: enemies that stepped
+    std::vector<Handle> grounded;           // enemies that landed, in pass order
+    std::vector<Handle> target;             // per rocket: first enemy its path meets
+    std::vector<uint8_t> out;               // per rocket: left the screen
+    std::vector<int> x0, y0;                // per rocket: position before the tick
+};
+TickScratch tickScratch;      // simulation thread (and the chunks it hands out)
+
+int tickChunks(size_t n) { return (int)((n + TICK_CHUNK - 1) / TICK_CHUNK); }
+
+// advance enemies; caller holds enemyListMutex. The ones that land stay in the
+// tables and the grid on their landing cell until groundEnemies, so the rocket
+// sweep can still meet them on the way down.
+void tickEnemies() {
+    TickScratch &sc = tickScratch;
+    int step = settings.enemy_step_ms;
+    size_t n = enemies.size();
+    int chunks = tickChunks(n);
+    sc.landed.resize(n);
+    if ((int)sc.moved.size() < chunks) sc.moved.resize(chunks);
+
+    auto stepChunk = [&](int c, int) {
+        std::vector<int> &moved = sc.moved[c];
+        moved.clear();
+        size_t end = std::min(n, (size_t)(c + 1) * TICK_CHUNK);
+        for (size_t i = (size_t)c * TICK_CHUNK; i < end; ++i) {
+            int &y = enemies.y[i];
+            int &acc = enemies.stepAcc[i];
+            bool landed = false;
+            enemies.prevY[i] = y;
+            acc += TICK_MS;
+            while (!landed && acc >= step) {
+                acc -= step;
+                y += 1;
+                traceInstant("enemy move", "enemy", enemies.id[i]);
+                landed = y >= SCREEN_H-2;
             }
-            pthread_mutex_unlock(&enemyListMutex);
-            break;
+            sc.landed[i] = landed;
+            if (y != enemies.prevY[i]) moved.push_back((int)i);
         }
+    };
+    tickPool.run(chunks, stepChunk);
+
+    // the grid follows the enemies that stepped, landed ones included
+    sc.grounded.clear();
+    for (int c = 0; c < chunks; ++c) {
+        for (int i : sc.moved[c]) {
+            int slot = (int)enemies.index.slotAt(i);
+            enemyGrid.move(slot, enemies.x[i], enemies.prevY[i], enemies.x[i], enemies.y[i]);
+            if (sc.landed[i]) sc.grounded.push_back(enemies.index.handleOf(slot));
+        }
+    }
+}
+
+// reclaim the enemies that landed this tick and no rocket met on the way;
+// caller holds enemyListMutex, after tickRockets
+void groundEnemies() {
+    for (Handle h : tickScratch.grounded) {
+        int i = enemies.find(h);
+        if (i < 0) continue;                  // shot down on its landing step
+        traceInstant("ground", "enemy", enemies.id[i]);
+        enemyGrid.remove((int)h.index, enemies.x[i], enemies.y[i]);
+        enemies.erase(h);
+        groundHits++;
     }
+}
+
+// advance rockets and resolve hits; caller holds enemyListMutex and rocketListMutex.
+// Runs after tickEnemies: each rocket's path over the tick is swept against
+// the enemies' paths, so the two cannot pass through each other between
+// samples however many cells either covers in a tick.
+void tickRockets() {
+    TickScratch &sc = tickScratch;
+    int step = settings.enemy_step_ms;
+    int reach = (TICK_MS + step - 1) / step;     // most rows an enemy moves in a tick
+    size_t n = rockets.size();
+    int chunks = tickChunks(n);
+    sc.target.resize(n);
+    sc.out.resize(n);
+    sc.x0.resize(n);
+    sc.y0.resize(n);
+
+    // move and find each rocket's first contact against the enemies as they stand
+    auto moveChunk = [&](int c, int) {
+        size_t end = std::min(n, (size_t)(c + 1) * TICK_CHUNK);
+        for (size_t i = (size_t)c * TICK_CHUNK; i < end; ++i) {
+            int &x = rockets.x[i], &y = rockets.y[i];
+            int &acc = rockets.stepAcc[i];
+            sc.x0[i] = x;
+            sc.y0[i] = y;
+            sc.target[i] = Handle();
+            sc.out[i] = false;
+            acc += TICK_MS;
+            int steps = acc / rocketStepMs;
+            if (steps > 0) {
+                acc -= steps * rocketStepMs;
+                int dx, dy;
+                aimToStep(rockets.aim[i], dx, dy);
+                x += steps * dx;
+                y += steps * dy;
+                traceInstant("rocket move", "rocket", rockets.id[i]);
+            }
 
+            // a rocket that did not step is a point: enemies can still fall onto it
+            int slot = sweptEnemyHit(sc.x0[i], sc.y0[i], x, y, reach);
+            if (slot != -1) sc.target[i] = enemies.index.handleOf(slot);
+            sc.out[i] = rocketOffscreen(x, y);
+        }
+    };
+    tickPool.run(chunks, moveChunk);
+
+    // kills in single-pass order; a rocket whose target an earlier rocket
+    // already destroyed sweeps again against the enemies left
+    for (size_t i = 0; i < rockets.size(); ) {
+        Handle h = sc.target[i];
+        if (h.index != UINT32_MAX && enemies.find(h) < 0) {
+            int slot = sweptEnemyHit(sc.x0[i], sc.y0[i], rockets.x[i], rockets.y[i], reach);
+            h = slot == -1 ? Handle() : enemies.index.handleOf(slot);
+        }
+        bool hit = h.index != UINT32_MAX;
+        if (hit) killEnemy((int)h.index);
+        if (hit || sc.out[i]) {
+            uint32_t last = (uint32_t)rockets.size() - 1;
+            rockets.eraseAt(i);
+            swapRemove((uint32_t)i, last, sc.target, sc.out, sc.x0, sc.y0);
+        } else {
+            ++i;
+        }
+    }
+}
+
+// simulationThread: fixed-timestep loop driving every enemy and rocket
+void* simulationThreadFn(void* arg) {
+    traceThread("simulation");
+    int64_t next = gameClock->nowMs();
+    uint32_t tick = 0;
+    while (gameRunning) {
+        next += TICK_MS;
+        int64_t t0 = steadyNowNs();
+        drainCommands(tick++);
+
+        // lock order: enemies before rockets
+        enemyListMutex.lock();
+        rocketListMutex.lock();
+        tickEnemies();
+        tickRockets();
+        groundEnemies();
+        if (!headless) publishSnapshot();
+        rocketListMutex.unlock();
+        enemyListMutex.unlock();
+        tickTimes.record(steadyNowNs() - t0);
+        if (tracing) traceEnd("tick", t0, "tick", tick - 1);
+
+        waitForTick(next, tick);
+    }
+    return nullptr;
+}
+
+// renderThread: the only thread drawing the game, paced at targetFps
+void* renderThreadFn(void* arg) {
+    auto period = std::chrono::microseconds(1000000 / targetFps);
+    auto next = std::chrono::steady_clock::now();
+    traceThread("render");
+    while (renderRunning) {
+        next += period;
+        int64_t t0 = steadyNowNs();
+        drawScreen();
+        frameTimes.record(steadyNowNs() - t0);
+        if (tracing) traceEnd("frame", t0);
+        renderStop.sleepUntil(next);
+    }
     return nullptr;
 }
 
@@ -273,6 +2583,7 @@ void* enemyThreadFn(void* arg) {
 void* enemySpawnerFn(void* arg) {
     std::uniform_int_distribution<int> distX(2, SCREEN_W - 4);
     int m = settings.m_enemies;
+    traceThread("spawner");
 
     for (int i = 0; i < m && gameRunning; ++i) {
         Enemy e;
@@ -280,228 +2591,451 @@ void* enemySpawnerFn(void* arg) {
         e.x = distX(rng);
         e.y = 1;
         e.alive = true;
-
-        pthread_mutex_lock(&enemyListMutex);
-        enemies.push_back(e);
-        pthread_mutex_unlock(&enemyListMutex);
-
-        // spawn thread for enemy
-        Enemy* earg = new Enemy;
-        *earg = e;
-        pthread_t tid;
-        pthread_create(&tid, nullptr, enemyThreadFn, earg);
-
-        // store tid inside list
-        pthread_mutex_lock(&enemyListMutex);
-        for (auto &ge : enemies) if (ge.id == e.id) ge.tid = tid;
-        pthread_mutex_unlock(&enemyListMutex);
+        e.stepAcc = 0;
+
+        enemyListMutex.lock();
+        e.self = enemies.insert(e);
+        enemyGrid.insert((int)e.self.index, e.x, e.y);
+        enemyListMutex.unlock();
+
+        if (engineMode == ENGINE_THREADS) {
+            // hand the enemy to a worker thread
+            Enemy* earg = enemyArgs.acquire();   // sized for every enemy of the game
+            *earg = e;
+            if (!entityWorkers.submit(enemyThreadFn, earg)) {
+                // no thread for it: the enemy is not spawned
+                enemyArgs.release(earg);
+                enemyListMutex.lock();
+                enemyGrid.remove((int)e.self.index, e.x, e.y);
+                enemies.erase(e.self);
+                enemyListMutex.unlock();
+                gameClock->sleepFor(settings.spawn_interval_ms);
+                continue;
+            }
+        }
 
         spawnedEnemies++;
-        std::this_thread::sleep_for(std::chrono::milliseconds(settings.spawn_interval_ms));
+        traceInstant("spawn", "enemy", e.id);
+        gameClock->sleepFor(settings.spawn_interval_ms);
     }
 
     spawnDone = true;
     return nullptr;
 }
 
-// reloadThread: refills launchers from infinite loader
+// reloadThread: one loader (arg = its index); takes emptied launchers from
+// the queue in firing order and refills them one at a time
 void* reloadThreadFn(void* arg) {
-    while (gameRunning) {
-        pthread_mutex_lock(&batteryMutex);
-        // check if all launchers full -> sleep on cond
-        bool allFull = true;
-        for (bool b : launchers) if (!b) { allFull = false; break; }
-        if (allFull) {
-            // wait until a launcher becomes empty (signal fired when rocket removed/fired)
-            pthread_cond_wait(&batteryNotFull, &batteryMutex);
-            pthread_mutex_unlock(&batteryMutex);
-            continue;
-        }
-        // find first empty and reload one by one with delay
-        for (int i = 0; i < k_launchers_global && gameRunning; ++i) {
-            if (!launchers[i]) {
-                // simulate travel/time to load single launcher
-                pthread_mutex_unlock(&batteryMutex);
-                std::this_thread::sleep_for(std::chrono::milliseconds(settings.reload_time_ms));
-                pthread_mutex_lock(&batteryMutex);
-                if (!launchers[i]) {
-                    launchers[i] = true;
-                    // after filling one, update draw etc.
-                    pthread_cond_signal(&batteryNotFull); // maybe others waiting
-                }
-            }
+    LoaderStats& st = loaderStats[(intptr_t)arg];
+    traceThread("loader %d", (int)(intptr_t)arg);
+    while (true) {
+        // wait until a shot queues a launcher or the game stops;
+        // both are changed and signalled under batteryMutex
+        batteryMutex.lock();
+        while (gameRunning && reloadJobs.empty())
+            batteryMutex.wait(gameClock, &reloadWork, -1);
+        if (!gameRunning) {
+            batteryMutex.unlock();
+            break;
         }
-        pthread_mutex_unlock(&batteryMutex);
+        ReloadJob job = reloadJobs.pop();
+        batteryMutex.unlock();
+
+        // simulate travel/time to load single launcher
+        int64_t traceStart = traceBegin();
+        int64_t start = gameClock->nowMs();
+        st.queuedTotalMs += start - job.emptiedMs;
+        st.queuedMaxMs = std::max(st.queuedMaxMs, start - job.emptiedMs);
+        gameClock->sleepFor(settings.reload_time_ms);
+        if (!gameRunning) break;       // cut short by the game ending: not a reload
+        battery.load(job.launcher);
+        int64_t done = gameClock->nowMs();
+
+        st.busyMs += done - start;
+        st.jobs++;
+        st.latencyTotalMs += done - job.emptiedMs;
+        st.latencyMaxMs = std::max(st.latencyMaxMs, done - job.emptiedMs);
+        reloadTimes.record((done - job.emptiedMs) * 1000000);
+        traceEnd("reload", traceStart, "launcher", job.launcher);
     }
     return nullptr;
 }
 
-// player controller thread: reads keys and does firing
+// player controller thread: sleeps in poll() until a key arrives (or the
+// game ends), then drains every pending key and queues its command.
+// screenMutex is taken only around wgetch, never while idle.
 void* playerControllerFn(void* arg) {
-    // We'll read keys from gamewin with getch in non-blocking mode
     nodelay(gamewin, TRUE);
     keypad(gamewin, TRUE);
+    traceThread("input");
 
-    int ch;
+    pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { inputWake[0], POLLIN, 0 } };
     while (gameRunning) {
-        pthread_mutex_lock(&screenMutex);
-        ch = wgetch(gamewin);
-        pthread_mutex_unlock(&screenMutex);
-
-        if (ch == ERR) {
-            std::this_thread::sleep_for(30ms);
-            continue;
-        }
-
-        if (ch == 'q' || ch == 'Q') {
-            gameRunning = false;
-            pthread_cond_broadcast(&batteryNotFull); // wake reload thread
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
             break;
         }
-
-        bool fired = false;
-        if (ch == KEY_UP || ch == 'w' || ch == 'W') {
-            pthread_mutex_lock(&batteryMutex); currentAim = AIM_UP; pthread_mutex_unlock(&batteryMutex);
-        } else if (ch == KEY_LEFT || ch == 'a' || ch == 'A') {
-            pthread_mutex_lock(&batteryMutex); currentAim = AIM_LEFT; pthread_mutex_unlock(&batteryMutex);
-        } else if (ch == KEY_RIGHT || ch == 'd' || ch == 'D') {
-            pthread_mutex_lock(&batteryMutex); currentAim = AIM_RIGHT; pthread_mutex_unlock(&batteryMutex);
-        } else if (ch == 'z' || ch == 'Z') {
-            pthread_mutex_lock(&batteryMutex); currentAim = AIM_UPLEFT; pthread_mutex_unlock(&batteryMutex);
-        } else if (ch == 'c' || ch == 'C') {
-            pthread_mutex_lock(&batteryMutex); currentAim = AIM_UPRIGHT; pthread_mutex_unlock(&batteryMutex);
-        } else if (ch == ' ' ) {
-            // attempt fire: consume first launcher that contains a rocket
-            pthread_mutex_lock(&batteryMutex);
-            int chosen = -1;
-            for (int i = 0; i < k_launchers_global; ++i) {
-                if (launchers[i]) { chosen = i; break; }
+        if (fds[1].revents) break;                                  // woken for shutdown
+        if (fds[0].revents & (POLLHUP | POLLERR | POLLNVAL)) break; // no terminal left
+
+        while (gameRunning) {
+            screenMutex.lock();
+            int ch = wgetch(gamewin);
+            screenMutex.unlock();
+            if (ch == ERR) break;
+            traceInstant("key", "ch", ch);
+
+            if (ch == 'q' || ch == 'Q') {
+                // a replay is only watched: quitting it is not part of the game
+                if (replaying) stopGame();
+                else submitCommand(CMD_QUIT);
+                return nullptr;
             }
-            if (chosen != -1) {
-                launchers[chosen] = false; // consume rocket
-                fired = true;
+            if (ch == 'p' || ch == 'P') {
+                statsOverlay = !statsOverlay;
+                continue;
             }
-            // if after consumption there's any empty launcher, wake reloadThread
-            pthread_cond_signal(&batteryNotFull);
-            pthread_mutex_unlock(&batteryMutex);
-
-            if (fired) {
-                // create rocket at bottom center-ish
-                Rocket rr;
-                rr.id = nextRocketId++;
-                rr.aim = currentAim;
-                rr.active = true;
-
-                // starting position: center-bottom above ground
-                rr.x = SCREEN_W / 2;
-                rr.y = SCREEN_H - 3;
-
-                // push and start thread
-                pthread_mutex_lock(&rocketListMutex);
-                rockets.push_back(rr);
-                pthread_mutex_unlock(&rocketListMutex);
-
-                Rocket* rarg = new Rocket;
-                *rarg = rr;
-                pthread_t rtid;
-                pthread_create(&rtid, nullptr, rocketThreadFn, rarg);
-
-                // store tid
-                pthread_mutex_lock(&rocketListMutex);
-                for (auto &gr : rockets) if (gr.id == rr.id) gr.tid = rtid;
-                pthread_mutex_unlock(&rocketListMutex);
-            } else {
-                // optional: beep or message (no rockets available)
-                pthread_mutex_lock(&screenMutex);
-                mvwprintw(gamewin, SCREEN_H-3, 2, "No rockets available!");
-                wrefresh(gamewin);
-                pthread_mutex_unlock(&screenMutex);
-                std::this_thread::sleep_for(300ms);
+            if (replaying) continue;
+
+            if (ch == KEY_UP || ch == 'w' || ch == 'W') {
+                submitCommand(CMD_AIM_UP);
+            } else if (ch == KEY_LEFT || ch == 'a' || ch == 'A') {
+                submitCommand(CMD_AIM_LEFT);
+            } else if (ch == KEY_RIGHT || ch == 'd' || ch == 'D') {
+                submitCommand(CMD_AIM_RIGHT);
+            } else if (ch == 'z' || ch == 'Z') {
+                submitCommand(CMD_AIM_UPLEFT);
+            } else if (ch == 'c' || ch == 'C') {
+                submitCommand(CMD_AIM_UPRIGHT);
+            } else if (ch == ' ' ) {
+                submitCommand(CMD_FIRE);
             }
         }
-        // redraw
-        drawScreen();
-        std::this_thread::sleep_for(30ms);
     }
     return nullptr;
 }
 
-// ---------- Helpers for end-of-game and cleanup ----------
-void waitForAllThreadsAndCleanup() {
-    // Wait for enemy threads to finish
-    pthread_mutex_lock(&enemyListMutex);
-    for (auto &e : enemies) {
-        if (e.tid) pthread_join(e.tid, nullptr);
+// rocket steps until a rocket fired now with aim a meets the enemy at
+// (ex, ey0) with stepAcc accumulated (0 = never); mirrors the tick engine:
+// first step one tick after firing, the rest on the tick where another
+// rocketStepMs has accumulated, while the enemy keeps descending every
+// enemy_step_ms. A slanted or sideways aim crosses column ex on one step
+// only, so just that step is checked: the bot runs this for the whole wave.
+int interceptSteps(int ex, int ey0, int stepAcc, Aim a) {
+    int dx, dy;
+    aimToStep(a, dx, dy);
+    int x0 = SCREEN_W / 2, y0 = SCREEN_H - 3;
+    int first = 1, last = INT_MAX;
+    if (dx != 0) {
+        if ((ex - x0) % dx != 0 || (ex - x0) / dx < 1) return 0;
+        first = last = (ex - x0) / dx;
+    } else if (ex != x0) {
+        return 0;
+    }
+    for (int n = first; n <= last; ++n) {
+        // the path is a straight line from inside the field: once out, it stays out
+        int x = x0 + n * dx, y = y0 + n * dy;
+        if (x < 1 || x >= SCREEN_W-1 || y < 1 || y >= SCREEN_H-2) return 0;
+        int t = std::max(1, ((n - 1) * rocketStepMs + TICK_MS - 1) / TICK_MS) * TICK_MS;
+        int ey = ey0 + (stepAcc + t) / settings.enemy_step_ms;
+        if (ey == y) return n;
     }
-    pthread_mutex_unlock(&enemyListMutex);
+    return 0;
+}
+
+// botThread: headless stand-in for the player. Aims at the enemy a rocket
+// fired now would reach soonest and fires, skipping enemies already shot at.
+void* botThreadFn(void* arg) {
+    static const Aim aims[] = { AIM_UP, AIM_UPLEFT, AIM_UPRIGHT, AIM_LEFT, AIM_RIGHT };
+    std::vector<int> targeted;     // enemy ids with a rocket on the way
+    traceThread("bot");
+
+    while (gameRunning) {
+        int bestId = -1, bestSteps = 0;
+        Aim bestAim = AIM_UP;
+
+        enemyListMutex.lock();
+        for (size_t i = 0; i < enemies.size(); ++i) {
+            int id = enemies.id[i];
+            if (std::find(targeted.begin(), targeted.end(), id) != targeted.end()) continue;
+            for (Aim a : aims) {
+                int n = interceptSteps(enemies.x[i], enemies.y[i], enemies.stepAcc[i], a);
+                if (n > 0 && (bestId == -1 || n < bestSteps)) {
+                    bestId = id; bestSteps = n; bestAim = a;
+                }
+            }
+        }
+        enemyListMutex.unlock();
 
-    // Wait for rocket threads
-    pthread_mutex_lock(&rocketListMutex);
-    for (auto &r : rockets) {
-        if (r.tid) pthread_join(r.tid, nullptr);
+        if (bestId != -1 && batteryHasRocket()) {
+            submitCommand((uint8_t)bestAim);
+            submitCommand(CMD_FIRE);
+            targeted.push_back(bestId);
+        }
+        gameClock->sleepFor(BOT_THINK_MS);
     }
-    pthread_mutex_unlock(&rocketListMutex);
+    return nullptr;
+}
+
+// ---------- Helpers for end-of-game and cleanup ----------
+void waitForAllThreadsAndCleanup() {
+    // entity threads end on their own once gameRunning drops; the workers follow
+    if (engineMode == ENGINE_THREADS) entityWorkers.stop();
 }
 
 // ---------- Main ----------
-int main() {
-    // seed rng
-    rng.seed((unsigned)time(nullptr));
+// bench.cpp includes this file with ANTIAEREO_NO_MAIN to drive the functions above
+#ifndef ANTIAEREO_NO_MAIN
+void printUsage(const char* prog) {
+    fprintf(stderr,
+            "usage: %s [--difficulty easy|medium|hard] [--entity-threads] [--fps N] [--speed N]\n"
+            "       %s --headless [--fast | --speed N] [--difficulty easy|medium|hard] [--entity-threads]\n"
+            "  either form also takes: [--seed N] [--record FILE | --replay FILE] [--loaders N] [--stats] [--trace FILE]\n"
+            "                          [--rocket-step-ms N] [--enemy-step-ms N] [--workers N]\n"
+            "                          [--entity-workers N] [--entity-stack-kb N]\n"
+            "  --headless also takes:  [--enemies N] [--spawn-interval-ms N]\n",
+            prog, prog);
+}
 
-    // init ncurses
-    initscr();
-    noecho();
-    curs_set(FALSE);
-    keypad(stdscr, TRUE);
+int main(int argc, char** argv) {
+    // command line
+    int choice = 0;            // 0 = ask in the menu
+    double speed = -1;         // < 0: wall clock; 0: virtual, unpaced; N: virtual at N x
+    bool seeded = false;
+    const char* replayPath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--entity-threads") == 0) {
+            engineMode = ENGINE_THREADS;
+        } else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc
+                   && atoi(argv[i+1]) > 0 && atoi(argv[i+1]) <= 240) {
+            targetFps = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--headless") == 0) {
+            headless = true;
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            dumpStats = true;
+        } else if (strcmp(argv[i], "--fast") == 0) {
+            speed = 0;
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc && atof(argv[i+1]) >= 0) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--difficulty") == 0 && i + 1 < argc) {
+            const char* d = argv[++i];
+            if (strcmp(d, "easy") == 0) choice = 1;
+            else if (strcmp(d, "medium") == 0) choice = 2;
+            else if (strcmp(d, "hard") == 0) choice = 3;
+            else { printUsage(argv[0]); return 1; }
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            gameSeed = (uint32_t)strtoul(argv[++i], nullptr, 10);
+            seeded = true;
+        } else if (strcmp(argv[i], "--loaders") == 0 && i + 1 < argc
+                   && atoi(argv[i+1]) > 0 && atoi(argv[i+1]) <= 255) {
+            loaderCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc
+                   && atoi(argv[i+1]) > 0 && atoi(argv[i+1]) <= 64) {
+            workerCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--entity-workers") == 0 && i + 1 < argc
+                   && atoi(argv[i+1]) > 0 && atoi(argv[i+1]) <= 4096) {
+            entityWorkerCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--entity-stack-kb") == 0 && i + 1 < argc
+                   && atoi(argv[i+1]) > 0 && atoi(argv[i+1]) <= 65536) {
+            entityStackKb = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--rocket-step-ms") == 0 && i + 1 < argc
+                   && atoi(argv[i+1]) > 0 && atoi(argv[i+1]) <= 65535) {
+            rocketStepMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--enemy-step-ms") == 0 && i + 1 < argc
+                   && atoi(argv[i+1]) > 0 && atoi(argv[i+1]) <= 65535) {
+            enemyStepMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--enemies") == 0 && i + 1 < argc
+                   && atoi(argv[i+1]) > 0 && atoi(argv[i+1]) <= 1000000) {
+            enemyCount = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--spawn-interval-ms") == 0 && i + 1 < argc
+                   && atoi(argv[i+1]) >= 0 && atoi(argv[i+1]) <= 65535) {
+            spawnIntervalMs = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (recordPath && replayPath) {
+        printUsage(argv[0]);
+        return 1;
+    }
+    if (replayPath) {
+        if (!loadRecording(replayPath, recording)) {
+            fprintf(stderr, "%s: not a readable recording\n", replayPath);
+            return 1;
+        }
+        replaying = true;
+        choice = recording.difficulty;
+        gameSeed = recording.seed;
+        loaderCount = recording.loaders;
+        rocketStepMs = recording.rocketStepMs;
+        enemyStepMs = recording.enemyStepMs;
+        seeded = true;
+    }
+    if (recordPath || replaying) {
+        // reproducible only when commands land on ticks and threads run in a fixed order
+        if (engineMode == ENGINE_THREADS) {
+            fprintf(stderr, "--record / --replay need the tick engine (drop --entity-threads)\n");
+            return 1;
+        }
+        if (speed < 0) speed = headless ? 0 : 1;
+    }
+    if ((enemyCount > 0 || spawnIntervalMs >= 0) && (!headless || recordPath || replaying)) {
+        // stress waves: a recording stores neither, so it would not replay
+        fprintf(stderr, "--enemies / --spawn-interval-ms need --headless without --record / --replay\n");
+        return 1;
+    }
+    if ((enemyCount > 0 || spawnIntervalMs >= 0) && engineMode == ENGINE_THREADS) {
+        // a stress wave would need a thread for every enemy alive at once
+        fprintf(stderr, "--enemies / --spawn-interval-ms need the tick engine (drop --entity-threads)\n");
+        return 1;
+    }
+    if (speed == 0 && !headless) {
+        fprintf(stderr, "unpaced time (--fast / --speed 0) needs --headless\n");
+        return 1;
+    }
+    if (speed >= 0) {
+        virtualClock.setSpeed(speed);
+        gameClock = &virtualClock;
+    }
 
-    // adapt screen size constants
-    getmaxyx(stdscr, SCREEN_H, SCREEN_W);
-    if (SCREEN_H < 20) SCREEN_H = 20;
-    if (SCREEN_W < 60) SCREEN_W = 60;
+    // seed rng
+    if (!seeded) gameSeed = (uint32_t)time(nullptr);
+    rng.seed(gameSeed);
+
+    if (!headless) {
+        // init ncurses
+        initscr();
+        noecho();
+        curs_set(FALSE);
+        keypad(stdscr, TRUE);
+
+        // adapt screen size constants
+        getmaxyx(stdscr, SCREEN_H, SCREEN_W);
+        if (SCREEN_H < MIN_SCREEN_H) SCREEN_H = MIN_SCREEN_H;
+        if (SCREEN_W < MIN_SCREEN_W) SCREEN_W = MIN_SCREEN_W;
+        SCREEN_H = std::min(SCREEN_H, MAX_SCREEN_H);   // so the recording replays
+        SCREEN_W = std::min(SCREEN_W, MAX_SCREEN_W);
+    }
+    if (replaying) {
+        // the field size is part of the game
+        SCREEN_W = recording.width;
+        SCREEN_H = recording.height;
+    }
+    enemyGrid.reset(SCREEN_W, SCREEN_H);
 
     // choose difficulty
-    WINDOW* menu = newwin(10, 36, (SCREEN_H-10)/2, (SCREEN_W-36)/2);
-    box(menu, 0, 0);
-    mvwprintw(menu, 1, 2, "Choose difficulty:");
-    mvwprintw(menu, 3, 4, "1 - Easy");
-    mvwprintw(menu, 4, 4, "2 - Medium");
-    mvwprintw(menu, 5, 4, "3 - Hard");
-    mvwprintw(menu, 7, 2, "Use keys 1/2/3 then Enter");
-    wrefresh(menu);
-
-    int choice = 2;
-    int c;
-    keypad(menu, TRUE);
-    nodelay(menu, FALSE);
-    while (true) {
-        c = wgetch(menu);
-        if (c == '1') { choice = 1; break; }
-        if (c == '2') { choice = 2; break; }
-        if (c == '3') { choice = 3; break; }
-        if (c == 10) break;
+    if (choice == 0 && headless) choice = 2;
+    if (choice == 0) {
+        WINDOW* menu = newwin(10, 36, (SCREEN_H-10)/2, (SCREEN_W-36)/2);
+        box(menu, 0, 0);
+        mvwprintw(menu, 1, 2, "Choose difficulty:");
+        mvwprintw(menu, 3, 4, "1 - Easy");
+        mvwprintw(menu, 4, 4, "2 - Medium");
+        mvwprintw(menu, 5, 4, "3 - Hard");
+        mvwprintw(menu, 7, 2, "Use keys 1/2/3 then Enter");
+        wrefresh(menu);
+
+        choice = 2;
+        int c;
+        keypad(menu, TRUE);
+        nodelay(menu, FALSE);
+        while (true) {
+            c = wgetch(menu);
+            if (c == '1') { choice = 1; break; }
+            if (c == '2') { choice = 2; break; }
+            if (c == '3') { choice = 3; break; }
+            if (c == 10) break;
+        }
+        delwin(menu);
     }
-    delwin(menu);
-
-    if (choice == 1) settings = EASY;
-    else if (choice == 2) settings = MEDIUM;
-    else settings = HARD;
-
-    k_launchers_global = settings.k_launchers;
-    launchers.assign(k_launchers_global, true);
 
-    // create main game window
-    gamewin = newwin(SCREEN_H, SCREEN_W, 0, 0);
-
-    // start threads: spawner, reload, player controller
-    pthread_t spawnerTid, reloadTid, playerTid;
+    if (choice == 1) { settings = EASY; difficultyName = "EASY"; }
+    else if (choice == 2) { settings = MEDIUM; difficultyName = "MEDIUM"; }
+    else { settings = HARD; difficultyName = "HARD"; }
+    if (enemyStepMs > 0) settings.enemy_step_ms = enemyStepMs;
+    if (enemyCount > 0) settings.m_enemies = enemyCount;
+    if (spawnIntervalMs >= 0) settings.spawn_interval_ms = spawnIntervalMs;
+
+    battery.reset(settings.k_launchers, true);
+    reloadJobs.reset(settings.k_launchers);
+    loaderStats.assign(loaderCount, LoaderStats());
+    reserveEntityStorage();
+
+    if (!headless) {
+        // create main game window
+        gamewin = newwin(SCREEN_H, SCREEN_W, 0, 0);
+        frame.reset(SCREEN_W, SCREEN_H);
+        publishSnapshot();  // first frame, before any producer thread exists
+
+        if (pipe(inputWake) != 0) {
+            endwin();
+            perror("pipe");
+            return 1;
+        }
+    }
 
-    pthread_create(&spawnerTid, nullptr, enemySpawnerFn, nullptr);
-    pthread_create(&reloadTid, nullptr, reloadThreadFn, nullptr);
-    pthread_create(&playerTid, nullptr, playerControllerFn, nullptr);
+    // start threads: spawner, reload, player controller or bot (+ simulation in tick mode).
+    // main stays attached to the clock while it starts them and runs the main loop,
+    // so on virtual time nothing moves before every thread is queued.
+    pthread_t spawnerTid = 0, playerTid = 0, renderTid = 0, simTid = 0;
+    std::vector<pthread_t> loaderTids(loaderCount);
+    auto wallStart = std::chrono::steady_clock::now();
+    if (tracePath) {
+        tracing = true;
+        traceStartNs = steadyNowNs();
+    }
+    gameClock->attach();
+    traceThread("main");
+
+    // a thread that cannot be created ends the game before it starts;
+    // the joins below skip every tid left at 0
+    bool started = true;
+    if (engineMode == ENGINE_TICK) {
+        tickPool.start(workerCount);
+        if (!gameClock->spawn(&simTid, simulationThreadFn, nullptr)) {
+            simTid = 0;
+            started = false;
+        }
+    } else {
+        // by default one worker per enemy and per rocket that can be alive at once, up to a ceiling
+        int n = entityWorkerCount ? entityWorkerCount
+                                  : std::min(settings.m_enemies + maxRocketsInFlight(), MAX_ENTITY_WORKERS);
+        started = entityWorkers.start(gameClock, n, (size_t)entityStackKb * 1024);
+    }
+    if (started && !gameClock->spawn(&spawnerTid, enemySpawnerFn, nullptr)) {
+        spawnerTid = 0;
+        started = false;
+    }
+    for (int i = 0; i < loaderCount && started; ++i)
+        if (!gameClock->spawn(&loaderTids[i], reloadThreadFn, (void*)(intptr_t)i)) {
+            loaderTids[i] = 0;
+            started = false;
+        }
+    if (started && headless) {
+        if (!replaying && !gameClock->spawn(&playerTid, botThreadFn, nullptr)) {
+            playerTid = 0;
+            started = false;
+        }
+    } else if (started) {
+        if (pthread_create(&playerTid, nullptr, playerControllerFn, nullptr) != 0) {
+            playerTid = 0;
+            started = false;
+        } else if (pthread_create(&renderTid, nullptr, renderThreadFn, nullptr) != 0) {
+            renderTid = 0;
+            started = false;
+        }
+    }
+    if (!started) stopGame();
 
-    // main loop: draw screen and check end conditions
+    // main loop: check end conditions (the render thread draws)
     while (gameRunning) {
-        drawScreen();
 
         // termination conditions
         int m = settings.m_enemies;
@@ -510,71 +3044,177 @@ int main() {
 
         if (destroyed >= (m + 1)/2) {
             // victory
-            pthread_mutex_lock(&screenMutex);
-            mvwprintw(gamewin, SCREEN_H/2, SCREEN_W/2 - 8, "YOU WIN! (%d/%d)", destroyed, m);
-            wrefresh(gamewin);
-            pthread_mutex_unlock(&screenMutex);
+            showMessage(SCREEN_W/2 - 8, SCREEN_H/2, 0, "YOU WIN! (%d/%d)", destroyed, m);
+            gameResult = 1;
             gameRunning = false;
             break;
         }
         if (ground > m/2) {
-            pthread_mutex_lock(&screenMutex);
-            mvwprintw(gamewin, SCREEN_H/2, SCREEN_W/2 - 8, "YOU LOSE! (%d/%d)", ground, m);
-            wrefresh(gamewin);
-            pthread_mutex_unlock(&screenMutex);
+            showMessage(SCREEN_W/2 - 8, SCREEN_H/2, 0, "YOU LOSE! (%d/%d)", ground, m);
+            gameResult = -1;
             gameRunning = false;
             break;
         }
         // if spawn finished and all enemies are either destroyed or grounded, end and evaluate counts
         if (spawnDone) {
-            bool anyAlive = false;
-            pthread_mutex_lock(&enemyListMutex);
-            for (const auto &e : enemies) if (e.alive) { anyAlive = true; break; }
-            pthread_mutex_unlock(&enemyListMutex);
+            // dead enemies are reclaimed, so anything left in the list is alive
+            enemyListMutex.lock();
+            bool anyAlive = enemies.size() > 0;
+            enemyListMutex.unlock();
             if (!anyAlive) {
                 // all finished, check counts
                 if (destroyed >= (m+1)/2) {
-                    pthread_mutex_lock(&screenMutex);
-                    mvwprintw(gamewin, SCREEN_H/2, SCREEN_W/2 - 8, "YOU WIN! (%d/%d)", destroyed, m);
-                    wrefresh(gamewin);
-                    pthread_mutex_unlock(&screenMutex);
+                    showMessage(SCREEN_W/2 - 8, SCREEN_H/2, 0, "YOU WIN! (%d/%d)", destroyed, m);
+                    gameResult = 1;
                 } else {
-                    pthread_mutex_lock(&screenMutex);
-                    mvwprintw(gamewin, SCREEN_H/2, SCREEN_W/2 - 8, "YOU LOSE! (%d/%d)", ground, m);
-                    wrefresh(gamewin);
-                    pthread_mutex_unlock(&screenMutex);
+                    showMessage(SCREEN_W/2 - 8, SCREEN_H/2, 0, "YOU LOSE! (%d/%d)", ground, m);
+                    gameResult = -1;
                 }
                 gameRunning = false;
                 break;
             }
         }
 
-        std::this_thread::sleep_for(120ms);
+        int64_t t0 = traceBegin();
+        gameClock->sleepFor(MAIN_LOOP_MS);
+        traceEnd("sleep", t0, "ms", MAIN_LOOP_MS);
     }
+    int64_t gameMs = gameClock->nowMs();
+    traceInstant("game over", "result", gameResult);
 
     // notify threads to stop
-    gameRunning = false;
-    pthread_cond_broadcast(&batteryNotFull);
+    stopGame();
+    gameClock->detach();
 
     // wait joins
-    pthread_join(spawnerTid, nullptr);
-    pthread_join(reloadTid, nullptr);
-    pthread_join(playerTid, nullptr);
+    if (spawnerTid) pthread_join(spawnerTid, nullptr);
+    for (pthread_t t : loaderTids)
+        if (t) pthread_join(t, nullptr);
+    if (playerTid) pthread_join(playerTid, nullptr);
+    if (simTid) pthread_join(simTid, nullptr);
+    if (engineMode == ENGINE_TICK) tickPool.stop();
 
     waitForAllThreadsAndCleanup();
+    if (renderTid) {
+        // main draws the final screen itself
+        renderRunning = false;
+        renderStop.raise();
+        pthread_join(renderTid, nullptr);
+    }
+    int64_t shutdownNs = steadyNowNs() - stopRequestedNs.load();
+
+    if (!started) {
+        if (!headless) {
+            close(inputWake[0]);
+            close(inputWake[1]);
+            delwin(gamewin);
+            endwin();
+        }
+        fprintf(stderr, "could not start the game threads\n");
+        return 1;
+    }
+
+    // every thread is gone: the trace buffers are complete
+    bool traceFailed = tracePath && !writeTrace(tracePath);
+
+    bool recordFailed = false;
+    if (recordPath) {
+        recording.seed = gameSeed;
+        recording.difficulty = (uint8_t)choice;
+        recording.loaders = (uint8_t)loaderCount;
+        recording.width = (uint16_t)SCREEN_W;
+        recording.height = (uint16_t)SCREEN_H;
+        recording.rocketStepMs = (uint16_t)rocketStepMs;
+        recording.enemyStepMs = (uint16_t)enemyStepMs;
+        recordFailed = !saveRecording(recordPath, recording);
+    }
+
+    if (headless) {
+        if (recordFailed) fprintf(stderr, "%s: could not write recording\n", recordPath);
+        if (traceFailed) fprintf(stderr, "%s: could not write trace\n", tracePath);
+        long long wallMs = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - wallStart).count();
+        printf("difficulty: %s (k=%d m=%d)  seed: %u\n", difficultyName, settings.k_launchers, settings.m_enemies, gameSeed);
+        printf("engine: %s  clock: %s\n",
+               engineMode == ENGINE_TICK ? "tick" : "entity-threads",
+               speed < 0 ? "real" : speed == 0 ? "virtual" : "virtual (paced)");
+        printf("steps: rocket %d ms  enemy %d ms\n", rocketStepMs, settings.enemy_step_ms);
+        printf("result: %s\n", gameResult > 0 ? "WIN" : gameResult < 0 ? "LOSE" : "QUIT");
+        printf("destroyed: %d  ground hits: %d  spawned: %d/%d\n",
+               destroyedEnemies.load(), groundHits.load(), spawnedEnemies.load(), settings.m_enemies);
+        printf("pools: enemies %zu/%d  rockets %zu/%d (high-water/capacity)\n",
+               enemies.slotCount(), settings.m_enemies, rockets.slotCount(), maxRocketsInFlight());
+        if (engineMode == ENGINE_THREADS) {
+            printf("thread args: enemies %zu/%zu  rockets %zu/%zu  exhausted %zu\n",
+                   enemyArgs.highWater(), enemyArgs.capacity(), rocketArgs.highWater(),
+                   rocketArgs.capacity(), enemyArgs.exhausted() + rocketArgs.exhausted());
+            char fire[16];
+            printf("entity workers: %d  stack %zu KB  jobs %d  overflow %d (peak %d alive)  refused %d  fire->move p50 %s\n",
+                   entityWorkers.size(), entityWorkers.stackBytes() / 1024, entityWorkers.jobCount(),
+                   entityWorkers.overflowCount(), entityWorkers.overflowPeakCount(), entityWorkers.refusedCount(),
+                   formatNs(fireToMove.percentile(0.5), fire, sizeof(fire)));
+        }
+        if (engineMode == ENGINE_TICK && !replaying)
+            printf("commands: %llu applied  %llu dropped  max depth %zu  latency avg %.3f ms max %.3f ms\n",
+                   (unsigned long long)commandStats.applied, (unsigned long long)commandStats.dropped.load(),
+                   commandStats.maxDepth.load(),
+                   commandStats.applied ? commandStats.latencyTotalNs / 1e6 / commandStats.applied : 0.0,
+                   commandStats.latencyMaxNs / 1e6);
+        if (engineMode == ENGINE_TICK) {
+            // utilization: share of the time spent in parallel passes that each worker ran tasks
+            printf("workers: %d  utilization", tickPool.size());
+            for (int w = 0; w < tickPool.size(); ++w)
+                printf(" %.0f%%", tickPool.wallNs() ? 100.0 * tickPool.stats(w).busyNs / tickPool.wallNs() : 0.0);
+            printf("  steals");
+            for (int w = 0; w < tickPool.size(); ++w) printf(" %lld", (long long)tickPool.stats(w).steals);
+            printf("\n");
+        }
+        LoaderStats all;
+        printf("loaders: %d  utilization", loaderCount);
+        for (const LoaderStats& st : loaderStats) {
+            printf(" %.0f%%", gameMs ? 100.0 * st.busyMs / gameMs : 0.0);
+            all.jobs += st.jobs;
+            all.queuedTotalMs += st.queuedTotalMs;
+            all.queuedMaxMs = std::max(all.queuedMaxMs, st.queuedMaxMs);
+            all.latencyTotalMs += st.latencyTotalMs;
+            all.latencyMaxMs = std::max(all.latencyMaxMs, st.latencyMaxMs);
+        }
+        printf("  reloads: %d\n", all.jobs);
+        printf("reload: empty->start avg %lld ms max %lld ms  empty->loaded avg %lld ms max %lld ms\n",
+               (long long)(all.jobs ? all.queuedTotalMs / all.jobs : 0), (long long)all.queuedMaxMs,
+               (long long)(all.jobs ? all.latencyTotalMs / all.jobs : 0), (long long)all.latencyMaxMs);
+        rusage ru;
+        getrusage(RUSAGE_SELF, &ru);
+        printf("game time: %lld ms  wall time: %lld ms  max RSS: %ld KB\n", (long long)gameMs, wallMs, ru.ru_maxrss);
+        printf("shutdown: %.3f ms (stop -> every thread joined)\n", shutdownNs / 1e6);
+        if (dumpStats) {
+            printStats(stdout);
+            printLockProfile(stdout);
+        }
+        return 0;
+    }
 
     // final pause to show result
-    pthread_mutex_lock(&screenMutex);
-    mvwprintw(gamewin, SCREEN_H-4, 2, "Press any key to exit...");
-    wrefresh(gamewin);
-    pthread_mutex_unlock(&screenMutex);
+    showMessage(2, SCREEN_H-4, 0, "Press any key to exit...");
+    drawScreen();
 
     nodelay(gamewin, FALSE);
     wgetch(gamewin);
 
     // cleanup ncurses
+    close(inputWake[0]);
+    close(inputWake[1]);
     delwin(gamewin);
     endwin();
 
+    if (recordFailed) fprintf(stderr, "%s: could not write recording\n", recordPath);
+    if (traceFailed) fprintf(stderr, "%s: could not write trace\n", tracePath);
+    if (dumpStats) {
+        printf("shutdown: %.3f ms (stop -> every thread joined)\n", shutdownNs / 1e6);
+        printStats(stdout);
+        printLockProfile(stdout);
+    }
+
     return 0;
-}
\ No newline at end of file
+}
+#endif // ANTIAEREO_NO_MAIN